@@ -0,0 +1,234 @@
+//
+//  cpuTrace.h
+//  3D-Shooter
+//
+//  CPU tracing for frame hitches: TRACE_SCOPE("name") records when the enclosing block starts and
+//  ends. Every thread writes into a ring buffer of its own without locks, so the last seconds of
+//  all threads are always at hand, and writeChromeJson() dumps them for chrome://tracing or
+//  Perfetto. Compiling with CPU_TRACE=0 removes every scope; switched off at run time a scope
+//  costs one relaxed atomic load.
+//
+
+#ifndef cpuTrace_h
+#define cpuTrace_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef CPU_TRACE
+#define CPU_TRACE 1
+#endif
+
+// events each thread keeps; a frame records a few dozen, so this is minutes of frames
+const unsigned int TRACE_BUFFER_EVENTS = 1 << 15;
+
+struct TraceEvent
+{
+    const char* name;           // a string literal, only the pointer is stored
+    long long start;            // nanoseconds on the steady clock
+    long long end;
+};
+
+// one thread's events; only that thread writes, anyone may read a copy
+class TraceBuffer
+{
+public:
+    std::string threadName;
+    unsigned int threadId;
+
+    TraceBuffer(unsigned int id) : threadId(id), events(TRACE_BUFFER_EVENTS), head(0)
+    {
+    }
+
+    void push(const char* name, long long start, long long end)
+    {
+        unsigned long long h = head.load(std::memory_order_relaxed);
+        TraceEvent& event = events[h % TRACE_BUFFER_EVENTS];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // the events that ended at or after since, oldest first. The writer keeps going meanwhile,
+    // so whatever it may have overwritten during the copy is left out
+    void copy(long long since, std::vector<TraceEvent>& out) const
+    {
+        unsigned long long last = head.load(std::memory_order_acquire);
+        unsigned long long first = last > TRACE_BUFFER_EVENTS ? last - TRACE_BUFFER_EVENTS : 0;
+        std::vector<TraceEvent> copied;
+        copied.reserve((size_t)(last - first));
+        for (unsigned long long i = first; i < last; i++)
+            copied.push_back(events[i % TRACE_BUFFER_EVENTS]);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        unsigned long long after = head.load(std::memory_order_relaxed);
+        unsigned long long valid = after > TRACE_BUFFER_EVENTS ? after - TRACE_BUFFER_EVENTS : 0;
+        for (unsigned long long i = std::max(first, valid); i < last; i++)
+        {
+            const TraceEvent& event = copied[(size_t)(i - first)];
+            if (event.end >= since)
+                out.push_back(event);
+        }
+    }
+
+private:
+    std::vector<TraceEvent> events;
+    std::atomic<unsigned long long> head;   // events ever pushed
+};
+
+class CpuTrace
+{
+public:
+    CpuTrace() : enabled(true), origin(std::chrono::steady_clock::now())
+    {
+    }
+
+    void setEnabled(bool on)
+    {
+        enabled.store(on, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    long long now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // name the calling thread in the dump, e.g. "main" or "texture worker"
+    void nameThread(const std::string& name)
+    {
+        buffer().threadName = name;
+    }
+
+    void record(const char* name, long long start, long long end)
+    {
+        buffer().push(name, start, end);
+    }
+
+    // the last seconds of every thread as Chrome trace_event JSON
+    bool writeChromeJson(const char* path, double seconds)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "Could not write trace " << path << std::endl;
+            return false;
+        }
+        long long since = now() - (long long)(seconds * 1e9);
+        std::vector<TraceEvent> events;
+        size_t eventCount = 0;
+        bool first = true;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t b = 0; b < buffers.size(); b++)
+        {
+            const TraceBuffer& thread = *buffers[b];
+            file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.threadId
+                << ",\"args\":{\"name\":\"" << escape(thread.threadName) << "\"}}";
+            first = false;
+
+            events.clear();
+            thread.copy(since, events);
+            eventCount += events.size();
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                // microseconds, with the nanoseconds kept as decimals
+                file << ",\n{\"name\":\"" << escape(events[i].name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.threadId
+                    << ",\"ts\":" << events[i].start / 1000 << '.' << digits(events[i].start % 1000)
+                    << ",\"dur\":" << (events[i].end - events[i].start) / 1000 << '.' << digits((events[i].end - events[i].start) % 1000) << '}';
+            }
+        }
+        file << "\n]}\n";
+        std::cout << "Wrote " << eventCount << " trace events of the last " << seconds << " s to " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::atomic<bool> enabled;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;                                   // guards buffers, not their contents
+    std::vector<std::unique_ptr<TraceBuffer> > buffers; // kept after their threads exit
+
+    // the calling thread's buffer, registered on its first event
+    TraceBuffer& buffer()
+    {
+        thread_local TraceBuffer* mine = NULL;
+        if (!mine)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer((unsigned int)buffers.size() + 1)));
+            mine = buffers.back().get();
+            mine->threadName = "thread " + std::to_string(mine->threadId);
+        }
+        return *mine;
+    }
+
+    static std::string digits(long long fraction)
+    {
+        std::string text = std::to_string(fraction);
+        return std::string(3 - std::min<size_t>(text.size(), 3), '0') + text;
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string escaped;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '"' || text[i] == '\\')
+                escaped += '\\';
+            escaped += text[i];
+        }
+        return escaped;
+    }
+};
+
+// the one trace of this process
+inline CpuTrace& cpuTrace()
+{
+    static CpuTrace trace;
+    return trace;
+}
+
+// records the enclosing block when tracing is on; use through TRACE_SCOPE
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : name(name), start(cpuTrace().isEnabled() ? cpuTrace().now() : -1)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (start >= 0)
+            cpuTrace().record(name, start, cpuTrace().now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    long long start;
+};
+
+#if CPU_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// name must be a string literal
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif /* cpuTrace_h */
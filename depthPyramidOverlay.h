@@ -0,0 +1,81 @@
+//
+//  depthPyramidOverlay.h
+//  3D-Shooter
+//
+//  Debug view of the occlusion culler: its depth buffer and pyramid levels drawn in the bottom
+//  left corner of the screen, near in white and far in black.
+//
+
+#ifndef depthPyramidOverlay_h
+#define depthPyramidOverlay_h
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "shader.h"
+#include "glState.h"
+#include "occlusionCuller.h"
+
+class DepthPyramidOverlay
+{
+public:
+    DepthPyramidOverlay() : shader("vertexShaderForDepthPyramid.vs", "fragmentShaderForDepthPyramid.fs"), texture(0), VAO(0), width(0), height(0)
+    {
+        glGenTextures(1, &texture);
+        glState().bindTexture(OVERLAY_UNIT, GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+        // the quad's corners come from gl_VertexID, but core profile draws need some VAO bound
+        glGenVertexArrays(1, &VAO);
+
+        static constexpr UniformName PYRAMID = "pyramid";
+        shader.use();
+        shader.setInt(PYRAMID, OVERLAY_UNIT);
+    }
+
+    ~DepthPyramidOverlay()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteTextures(1, &texture);
+    }
+
+    // upload the culler's current pyramid and draw it at two pixels per texel over the frame
+    void draw(const OcclusionCuller& culler)
+    {
+        culler.debugImage(pixels, width, height);
+        glState().bindTexture(OVERLAY_UNIT, GL_TEXTURE_2D, texture);
+        glState().bindSampler(OVERLAY_UNIT, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // the window may have been resized since the viewport was last set from main()
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, width * 2, height * 2);
+        glState().setDepthTest(false);
+        shader.use();
+        glState().bindVertexArray(VAO);
+        glState().drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
+        glState().setDepthTest(true);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+private:
+    // unit 0 holds the scene's textures and their mipmapping sampler
+    static const unsigned int OVERLAY_UNIT = 1;
+
+    Shader shader;
+    GLuint texture;
+    GLuint VAO;
+    std::vector<unsigned char> pixels;
+    int width;
+    int height;
+};
+
+#endif /* depthPyramidOverlay_h */
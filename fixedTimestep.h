@@ -0,0 +1,56 @@
+//
+//  fixedTimestep.h
+//  3D-Shooter
+//
+//  Accumulator that turns variable frame times into a whole number of fixed simulation ticks,
+//  plus the fraction of a tick left over for interpolating what is drawn.
+//
+
+#ifndef fixedTimestep_h
+#define fixedTimestep_h
+
+// longest frame time we catch up on; after a longer hitch the game slows down instead of
+// running hundreds of ticks in one frame
+const float MAX_FRAME_TIME = 0.25f;
+
+class FixedTimestep
+{
+public:
+    explicit FixedTimestep(float ticksPerSecond) : step(1.0 / ticksPerSecond), accumulator(0.0)
+    {
+    }
+
+    // add the time of the frame that just started; returns how many ticks to simulate
+    unsigned int advance(float frameTime)
+    {
+        if (frameTime > MAX_FRAME_TIME)
+            frameTime = MAX_FRAME_TIME;
+        if (frameTime > 0.0f)
+            accumulator += frameTime;
+
+        unsigned int ticks = 0;
+        while (accumulator >= step)
+        {
+            accumulator -= step;
+            ticks++;
+        }
+        return ticks;
+    }
+
+    // how far we are between the last tick and the next one, 0 to 1
+    float getAlpha() const
+    {
+        return (float)(accumulator / step);
+    }
+
+    float getStep() const
+    {
+        return (float)step;
+    }
+
+private:
+    double step;
+    double accumulator;     // double, so many small frame times don't drift against the step
+};
+
+#endif /* fixedTimestep_h */
@@ -0,0 +1,201 @@
+//
+//  flightRecorder.h
+//  3D-Shooter
+//
+//  Always-on record of the last seconds of frames: how long each took, its deltaTime and its GL
+//  call counts. A frame that takes more than a factor times the median frame (and at least a
+//  minimum) is a hitch; a moment later, once the frames after it are in as well, the window
+//  around it is written to disk: the frames as CSV and the CPU trace of the same time as
+//  Chrome trace JSON, see cpuTrace.h.
+//
+
+#ifndef flightRecorder_h
+#define flightRecorder_h
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "cpuTrace.h"
+
+const unsigned int FLIGHT_RECORDER_FRAMES = 1024;   // ring size, more than the window at any sane frame rate
+const double FLIGHT_RECORDER_BEFORE = 4.0;          // seconds before a hitch that are written
+const double FLIGHT_RECORDER_AFTER = 1.0;           // and after it
+const unsigned int FLIGHT_RECORDER_WARMUP = 30;     // frames before hitches count, startup is always slow
+const unsigned int FLIGHT_RECORDER_MEDIAN_EVERY = 30;
+
+struct FlightFrame
+{
+    unsigned long long frame;
+    long long start;                // steady clock nanoseconds, as in cpuTrace()
+    long long end;
+    float periodMs;                 // since the previous frame ended, what the player sees
+    float workMs;                   // from this frame's start to after its swap
+    float deltaTime;                // what the game advanced by
+    unsigned long long drawCalls;
+    unsigned long long triangles;
+    unsigned long long glCallsIssued;
+    unsigned long long glCallsSkipped;
+    bool hitch;
+};
+
+class FlightRecorder
+{
+public:
+    // hitches seen and windows written
+    unsigned int hitchCount;
+    unsigned int dumpCount;
+
+    FlightRecorder() : hitchCount(0), dumpCount(0), factor(2.0f), minimumMs(1000.0f / 60.0f), frames(FLIGHT_RECORDER_FRAMES),
+        count(0), frameStart(0), lastEnd(-1), median(0.0f), dumpAt(-1), hitchFrame(0), hitchMs(0.0f), hitchMedian(0.0f)
+    {
+    }
+
+    // a factor of 0 records but never writes anything; dumps go to directory
+    void configure(float hitchFactor, float hitchMinimumMs, const std::string& dumpDirectory)
+    {
+        factor = hitchFactor;
+        minimumMs = hitchMinimumMs;
+        directory = dumpDirectory;
+    }
+
+    // the frame boundaries: beginFrame at the top of the render loop, endFrame right after the swap
+    void beginFrame()
+    {
+        frameStart = cpuTrace().now();
+    }
+
+    void endFrame(float deltaTime, unsigned long long drawCalls, unsigned long long triangles, unsigned long long glCallsIssued,
+        unsigned long long glCallsSkipped)
+    {
+        long long end = cpuTrace().now();
+        FlightFrame& f = frames[count % FLIGHT_RECORDER_FRAMES];
+        f.frame = count;
+        f.start = frameStart;
+        f.end = end;
+        f.workMs = (float)((end - frameStart) / 1.0e6);
+        f.periodMs = lastEnd < 0 ? f.workMs : (float)((end - lastEnd) / 1.0e6);
+        f.deltaTime = deltaTime;
+        f.drawCalls = drawCalls;
+        f.triangles = triangles;
+        f.glCallsIssued = glCallsIssued;
+        f.glCallsSkipped = glCallsSkipped;
+        f.hitch = false;
+        lastEnd = end;
+        count++;
+
+        if (count % FLIGHT_RECORDER_MEDIAN_EVERY == 0)
+            updateMedian();
+        if (factor > 0.0f && count > FLIGHT_RECORDER_WARMUP && median > 0.0f && f.periodMs > factor * median && f.periodMs > minimumMs)
+        {
+            f.hitch = true;
+            hitchCount++;
+            cpuTrace().record("hitch", end - (long long)(f.periodMs * 1.0e6), end);
+            // later hitches before the dump go into the same window
+            if (dumpAt < 0)
+            {
+                dumpAt = end + (long long)(FLIGHT_RECORDER_AFTER * 1.0e9);
+                hitchFrame = f.frame;
+                hitchMs = f.periodMs;
+                hitchMedian = median;
+            }
+        }
+        if (dumpAt >= 0 && end >= dumpAt)
+        {
+            dump();
+            dumpAt = -1;
+            // writing the dump is our own stall, not the next frame's
+            lastEnd = cpuTrace().now();
+        }
+    }
+
+    // write a hitch still waiting for its frames after, e.g. when the game quits
+    void finish()
+    {
+        if (dumpAt >= 0)
+            dump();
+        dumpAt = -1;
+    }
+
+private:
+    float factor;
+    float minimumMs;
+    std::string directory;
+    std::vector<FlightFrame> frames;
+    unsigned long long count;       // frames ever recorded
+    long long frameStart;
+    long long lastEnd;
+    float median;                   // frame period over the last FLIGHT_RECORDER_BEFORE seconds
+    long long dumpAt;               // when the pending hitch's window is complete, -1 for none
+    unsigned long long hitchFrame;
+    float hitchMs;
+    float hitchMedian;
+    std::vector<float> scratch;
+
+    // the recorded frames still in the ring that ended at or after since, oldest first
+    template <typename F>
+    void forEachFrame(long long since, F f) const
+    {
+        unsigned long long first = count > FLIGHT_RECORDER_FRAMES ? count - FLIGHT_RECORDER_FRAMES : 0;
+        for (unsigned long long i = first; i < count; i++)
+        {
+            const FlightFrame& frame = frames[i % FLIGHT_RECORDER_FRAMES];
+            if (frame.end >= since)
+                f(frame);
+        }
+    }
+
+    void updateMedian()
+    {
+        scratch.clear();
+        long long since = lastEnd - (long long)(FLIGHT_RECORDER_BEFORE * 1.0e9);
+        forEachFrame(since, [this](const FlightFrame& frame) { scratch.push_back(frame.periodMs); });
+        if (scratch.empty())
+            return;
+        std::nth_element(scratch.begin(), scratch.begin() + scratch.size() / 2, scratch.end());
+        median = scratch[scratch.size() / 2];
+    }
+
+    void dump()
+    {
+        if (directory.empty())
+            return;
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        long long now = cpuTrace().now();
+        long long since = now - (long long)((FLIGHT_RECORDER_BEFORE + FLIGHT_RECORDER_AFTER) * 1.0e9);
+        std::string base = directory + "/hitch-" + std::to_string(hitchFrame);
+
+        std::ofstream file((base + ".csv").c_str());
+        if (!file)
+        {
+            std::cout << "Could not write flight recorder dump " << base << ".csv" << std::endl;
+            return;
+        }
+        file << "frame,start_ms,period_ms,work_ms,delta_time,draw_calls,triangles,gl_calls_issued,gl_calls_skipped,hitch\n";
+        forEachFrame(since, [&file](const FlightFrame& f) {
+            file << f.frame << ',' << f.start / 1.0e6 << ',' << f.periodMs << ',' << f.workMs << ',' << f.deltaTime << ',' << f.drawCalls << ','
+                << f.triangles << ',' << f.glCallsIssued << ',' << f.glCallsSkipped << ',' << (f.hitch ? 1 : 0) << '\n';
+        });
+        file.close();
+        std::cout << "Hitch: frame " << hitchFrame << " took " << hitchMs << " ms against a median of " << hitchMedian << " ms, wrote "
+            << base << ".csv" << std::endl;
+        if (cpuTrace().isEnabled())
+            cpuTrace().writeChromeJson((base + ".json").c_str(), (now - since) / 1.0e9);
+        dumpCount++;
+    }
+};
+
+#endif /* flightRecorder_h */
@@ -2,9 +2,9 @@
 
 out vec4 FragColor;
 
-uniform vec3 color;
+in vec3 InstanceColor;
 
 void main()
 {
-    FragColor = vec4(color, 1.0f);
+    FragColor = vec4(InstanceColor, 1.0f);
 }
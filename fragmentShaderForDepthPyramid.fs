@@ -0,0 +1,13 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// brightness of the occlusion culler's depth pyramid, see occlusionCuller.h
+uniform sampler2D pyramid;
+
+void main()
+{
+    FragColor = vec4(vec3(texture(pyramid, TexCoords).r), 1.0);
+}
@@ -1,6 +1,20 @@
 #version 330 core
 out vec4 FragColor;
 
+// variant switches, see shaderVariants.h; left undefined they give the full shader
+#ifndef TEXTURED
+#define TEXTURED 1              // sample the texture array; layer -1 still means untextured
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 1          // clustered point lights
+#endif
+#ifndef DIRECTIONAL_LIGHT
+#define DIRECTIONAL_LIGHT 1
+#endif
+#ifndef QUALITY
+#define QUALITY 1               // 0 drops the specular terms
+#endif
+
 struct Material {
     vec3 ambient;
     vec3 diffuse;
@@ -12,43 +26,38 @@ struct Material {
 
 struct PointLight {
     vec3 position;
-    
     float k_c;  // attenuation factors
-    float k_l;  // attenuation factors
-    float k_q;  // attenuation factors
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct DirectionalLight {              //Directional Light
-    vec3 direction;
-
     vec3 ambient;
+    float k_l;  // attenuation factors
     vec3 diffuse;
+    float k_q;  // attenuation factors
     vec3 specular;
+    float radius;   // the light fades out completely at this distance
 };
 
 
-
-#define NR_POINT_LIGHTS 4
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
+in vec3 InstanceColor;
+flat in float Layer;
+in vec4 ClipPos;
+
+#include "frameData.glsl"
 
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform DirectionalLight directionalLight;
 uniform Material material;
-uniform sampler2D texture1;
-uniform bool useTexture;
+uniform sampler2DArray textures;    // every scene texture, one per layer
+
+// clustered point lights, see lightClusters.h
+uniform samplerBuffer lights;           // four texels per light, laid out like PointLight
+uniform usamplerBuffer clusters;        // per froxel: first index and count in lightIndices
+uniform usamplerBuffer lightIndices;
 
 
 // function prototypes
 vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V);
 vec3 CalcDirLight(Material material, DirectionalLight light, vec3 N, vec3 fragPos);
+PointLight FetchPointLight(int index);
 
 void main()
 {
@@ -56,29 +65,40 @@ void main()
     vec3 N = normalize(Normal);
     vec3 V = normalize(viewPos - FragPos);
 
-    vec3 result;
-    // point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(material, pointLights[i], N, FragPos, V);
-
+    // instanced draws tint the material per instance
+    Material m = material;
+    m.ambient *= InstanceColor;
+    m.diffuse *= InstanceColor;
+
+    vec3 result = vec3(0.0);
+#if POINT_LIGHTS
+    // point lights: only the active ones binned into this fragment's froxel
+    ivec3 grid = ivec3(clusterSize.xyz);
+    ivec2 tile = clamp(ivec2(floor((ClipPos.xy / ClipPos.w * 0.5 + 0.5) * vec2(grid.xy))), ivec2(0), grid.xy - 1);
+    int slice = clamp(int(floor(log(ClipPos.w) * clusterDepth.x + clusterDepth.y)), 0, grid.z - 1);
+    uvec2 range = texelFetch(clusters, (slice * grid.y + tile.y) * grid.x + tile.x).xy;
+    for (uint i = 0u; i < range.y; i++)
+        result += CalcPointLight(m, FetchPointLight(int(texelFetch(lightIndices, int(range.x + i)).r)), N, FragPos, V);
+#endif
+
+#if DIRECTIONAL_LIGHT
     //Directional Light Calculation
-    vec3 dirL = CalcDirLight(material, directionalLight, N, FragPos);
-    result += dirL;
-
-    vec4 texColor = texture(texture1, TexCoord);
-    
-    if (useTexture) {
-        FragColor = texColor * vec4(result, 1.0);
-    } else {
-        FragColor = vec4(result, 1.0);
-    }
+    result += CalcDirLight(m, directionalLight, N, FragPos);
+#endif
+
+#if TEXTURED
+    // untextured parts of a textured batch (layer -1) are multiplied by white instead of branching
+    vec4 texColor = texture(textures, vec3(TexCoord, max(Layer, 0.0)));
+    FragColor = mix(vec4(1.0), texColor, step(0.0, Layer)) * vec4(result, 1.0);
+#else
+    FragColor = vec4(result, 1.0);
+#endif
 }
 
 // calculates the color when using a point light.
 vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V)
 {
     vec3 L = normalize(light.position - fragPos);
-    vec3 R = reflect(-L, N);
     
     vec3 K_A = material.ambient;
     vec3 K_D = material.diffuse;
@@ -87,10 +107,18 @@ vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, v
     // attenuation
     float d = length(light.position - fragPos);
     float attenuation = 1.0 / (light.k_c + light.k_l * d + light.k_q * (d * d));
+    // fade to zero at the radius so the cut-off where the light's clusters end can't show
+    float fade = clamp(1.0 - pow(d / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= fade * fade;
     
     vec3 ambient = K_A * light.ambient;
     vec3 diffuse = K_D * max(dot(N, L), 0.0) * light.diffuse;
+#if QUALITY > 0
+    vec3 R = reflect(-L, N);
     vec3 specular = K_S * pow(max(dot(V, R), 0.0), material.shininess) * light.specular;
+#else
+    vec3 specular = vec3(0.0);
+#endif
     
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -107,10 +135,23 @@ vec3 CalcDirLight(Material material, DirectionalLight light, vec3 N, vec3 fragPo
     float diff = max(dot(N, lightDir), 0.0);
     vec3 diffuse = light.diffuse * (diff * material.diffuse);
 
+#if QUALITY > 0
     vec3 viewDir = normalize(viewPos - fragPos);
     vec3 reflectDir = reflect(-lightDir, N);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     vec3 specular = light.specular * (spec * material.specular);
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     return (ambient + diffuse + specular);
 }
+
+PointLight FetchPointLight(int index)
+{
+    vec4 t0 = texelFetch(lights, index * 4);
+    vec4 t1 = texelFetch(lights, index * 4 + 1);
+    vec4 t2 = texelFetch(lights, index * 4 + 2);
+    vec4 t3 = texelFetch(lights, index * 4 + 3);
+    return PointLight(t0.xyz, t0.w, t1.xyz, t1.w, t2.xyz, t2.w, t3.xyz, t3.w);
+}
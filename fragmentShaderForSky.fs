@@ -0,0 +1,15 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoord;
+in vec3 InstanceColor;
+flat in float Layer;
+
+uniform sampler2DArray textures;    // every scene texture, one per layer
+
+// unlit: the tint stands in for the lighting the sky used to get
+void main()
+{
+    FragColor = vec4(texture(textures, vec3(TexCoord, Layer)).rgb * InstanceColor, 1.0);
+}
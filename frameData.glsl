@@ -0,0 +1,21 @@
+// per-frame camera and light state shared by every program, see frameData.h;
+// included by the shaders so all of them declare the same block
+
+struct DirectionalLight {
+    vec3 direction;
+    float enabled;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    DirectionalLight directionalLight;
+    uvec4 clusterSize;      // froxel grid: tiles across, tiles up, depth slices; active point lights
+    vec4 clusterDepth;      // slice = log(view depth) * x + y
+};
@@ -0,0 +1,94 @@
+//
+//  frameData.h
+//  3D-Shooter
+//
+//  Camera and light state shared by every program through one std140 uniform block. The point
+//  lights themselves live in a texture buffer, see lightClusters.h.
+//
+
+#ifndef frameData_h
+#define frameData_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+const unsigned int FRAME_DATA_BINDING = 0;
+
+// one point light as four RGBA32F texels of the light buffer, read by the Phong fragment shader
+struct PointLightData
+{
+    glm::vec3 position;
+    float k_c;
+    glm::vec3 ambient;
+    float k_l;
+    glm::vec3 diffuse;
+    float k_q;
+    glm::vec3 specular;
+    float radius;           // no light reaches past this distance
+};
+
+// the structs below mirror the std140 layout of the FrameData block in the shaders:
+// every vec3 starts on a 16 byte boundary, so the scalars are packed into the gaps
+struct DirectionalLightData
+{
+    glm::vec3 direction;
+    float enabled;          // 0 skips the light in the shader
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float pad;
+    DirectionalLightData directionalLight;
+    glm::uvec4 clusterSize;     // froxel grid: tiles across, tiles up, depth slices; active point lights
+    glm::vec4 clusterDepth;     // slice = log(view depth) * x + y; near and far plane in z and w
+};
+
+static_assert(sizeof(PointLightData) == 64, "PointLightData must be four vec4 texels");
+static_assert(sizeof(DirectionalLightData) == 64, "DirectionalLightData must follow std140 layout");
+static_assert(sizeof(FrameData) == 144 + 64 + 32, "FrameData must follow std140 layout");
+
+class FrameUniformBuffer
+{
+public:
+    unsigned int UBO;
+
+    FrameUniformBuffer() : UBO(0)
+    {
+    }
+
+    // allocate the buffer and bind it to its binding point for the lifetime of the program
+    void create()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, UBO);
+    }
+
+    // point the shader's FrameData block at the shared binding point
+    void attach(Shader& shader)
+    {
+        shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    }
+
+    // one upload per frame replaces all camera and light uniforms
+    void update(const FrameData& frame)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frame);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+#endif /* frameData_h */
@@ -0,0 +1,200 @@
+//
+//  frustum.h
+//  3D-Shooter
+//
+//  View frustum planes and a structure-of-arrays table of world-space boxes that is tested
+//  against them eight (AVX) or four (SSE) boxes at a time.
+//
+
+#ifndef frustum_h
+#define frustum_h
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#define BOUNDS_TABLE_AVX
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BOUNDS_TABLE_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <cmath>
+#include <vector>
+
+// axis-aligned box
+struct Bounds
+{
+    glm::vec3 lower;
+    glm::vec3 upper;
+};
+
+// box around a transformed box: each output extent sums the absolute matrix columns times the
+// input half extents
+inline Bounds transformBounds(const Bounds& bounds, const glm::mat4& transform)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4((bounds.lower + bounds.upper) * 0.5f, 1.0f));
+    glm::vec3 half = (bounds.upper - bounds.lower) * 0.5f;
+    glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * half.x + glm::abs(glm::vec3(transform[1])) * half.y
+        + glm::abs(glm::vec3(transform[2])) * half.z;
+    Bounds result = { center - extent, center + extent };
+    return result;
+}
+
+inline Bounds mergeBounds(const Bounds& a, const Bounds& b)
+{
+    Bounds result = { glm::min(a.lower, b.lower), glm::max(a.upper, b.upper) };
+    return result;
+}
+
+struct Frustum
+{
+    // xyz is the inward normal, w the distance; a point p is inside when dot(xyz, p) + w >= 0
+    glm::vec4 planes[6];
+
+    // planes of a projection * view matrix, in world space
+    void extract(const glm::mat4& viewProjection)
+    {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        planes[0] = row[3] + row[0];    // left
+        planes[1] = row[3] - row[0];    // right
+        planes[2] = row[3] + row[1];    // bottom
+        planes[3] = row[3] - row[1];    // top
+        planes[4] = row[3] + row[2];    // near
+        planes[5] = row[3] - row[2];    // far
+        for (int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+};
+
+class BoundsTable
+{
+public:
+    void clear()
+    {
+        minX.clear();
+        minY.clear();
+        minZ.clear();
+        maxX.clear();
+        maxY.clear();
+        maxZ.clear();
+    }
+
+    // returns the box's index
+    unsigned int add(const Bounds& bounds)
+    {
+        minX.push_back(bounds.lower.x);
+        minY.push_back(bounds.lower.y);
+        minZ.push_back(bounds.lower.z);
+        maxX.push_back(bounds.upper.x);
+        maxY.push_back(bounds.upper.y);
+        maxZ.push_back(bounds.upper.z);
+        return (unsigned int)minX.size() - 1;
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)minX.size();
+    }
+
+    Bounds get(unsigned int i) const
+    {
+        Bounds bounds = { glm::vec3(minX[i], minY[i], minZ[i]), glm::vec3(maxX[i], maxY[i], maxZ[i]) };
+        return bounds;
+    }
+
+    // append the indices of the boxes at least partly inside the frustum, in increasing order. A
+    // box is outside when its corner furthest along a plane's normal is behind that plane; boxes
+    // near frustum corners can pass all six tests while outside, which only costs a wasted draw
+    void cull(const Frustum& frustum, std::vector<unsigned int>& visible) const
+    {
+        // the furthest corner takes max on axes where the normal is positive, so the choice of
+        // array is made once per plane instead of once per box
+        const float* xs[6];
+        const float* ys[6];
+        const float* zs[6];
+        for (int p = 0; p < 6; p++)
+        {
+            xs[p] = frustum.planes[p].x >= 0.0f ? maxX.data() : minX.data();
+            ys[p] = frustum.planes[p].y >= 0.0f ? maxY.data() : minY.data();
+            zs[p] = frustum.planes[p].z >= 0.0f ? maxZ.data() : minZ.data();
+        }
+
+        unsigned int count = size();
+        unsigned int i = 0;
+#if defined(BOUNDS_TABLE_AVX)
+        __m256 nx[6], ny[6], nz[6], nw[6];
+        for (int p = 0; p < 6; p++)
+        {
+            nx[p] = _mm256_set1_ps(frustum.planes[p].x);
+            ny[p] = _mm256_set1_ps(frustum.planes[p].y);
+            nz[p] = _mm256_set1_ps(frustum.planes[p].z);
+            nw[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+        const __m256 zero = _mm256_setzero_ps();
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+            for (int p = 0; p < 6; p++)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], _mm256_loadu_ps(xs[p] + i)), _mm256_mul_ps(ny[p], _mm256_loadu_ps(ys[p] + i))),
+                    _mm256_add_ps(_mm256_mul_ps(nz[p], _mm256_loadu_ps(zs[p] + i)), nw[p]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+            }
+            int mask = _mm256_movemask_ps(inside);
+            for (int lane = 0; mask != 0; lane++, mask >>= 1)
+            {
+                if (mask & 1)
+                    visible.push_back(i + lane);
+            }
+        }
+#elif defined(BOUNDS_TABLE_SSE)
+        __m128 nx[6], ny[6], nz[6], nw[6];
+        for (int p = 0; p < 6; p++)
+        {
+            nx[p] = _mm_set1_ps(frustum.planes[p].x);
+            ny[p] = _mm_set1_ps(frustum.planes[p].y);
+            nz[p] = _mm_set1_ps(frustum.planes[p].z);
+            nw[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], _mm_loadu_ps(xs[p] + i)), _mm_mul_ps(ny[p], _mm_loadu_ps(ys[p] + i))),
+                    _mm_add_ps(_mm_mul_ps(nz[p], _mm_loadu_ps(zs[p] + i)), nw[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; mask != 0; lane++, mask >>= 1)
+            {
+                if (mask & 1)
+                    visible.push_back(i + lane);
+            }
+        }
+#endif
+        // the boxes left over after the last full group, or all of them without SIMD
+        for (; i < count; i++)
+        {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++)
+            {
+                const glm::vec4& plane = frustum.planes[p];
+                inside = plane.x * xs[p][i] + plane.y * ys[p][i] + plane.z * zs[p][i] + plane.w >= 0.0f;
+            }
+            if (inside)
+                visible.push_back(i);
+        }
+    }
+
+private:
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+};
+
+#endif /* frustum_h */
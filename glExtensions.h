@@ -0,0 +1,149 @@
+//
+//  glExtensions.h
+//  3D-Shooter
+//
+//  Entry points newer than the GL 3.3 core profile glad was generated for. Each one is loaded only
+//  when the driver's version or extension list provides it and stays NULL otherwise, so callers
+//  check it and fall back to plain 3.3 code.
+//
+
+#ifndef glExtensions_h
+#define glExtensions_h
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// EXT_texture_compression_s3tc, EXT_texture_sRGB and GL 4.2 / ARB_texture_compression_bptc formats
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DEXTPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYEXTPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYEXTPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIEXTPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSEXTPROC)(GLuint count);
+
+class GLExtensions
+{
+public:
+    int major;
+    int minor;
+
+    // GL 4.2 / ARB_texture_storage
+    PFNGLTEXSTORAGE3DEXTPROC texStorage3D;
+
+    // GL 4.1 / ARB_get_program_binary, only set when the driver has at least one binary format
+    PFNGLGETPROGRAMBINARYEXTPROC getProgramBinary;
+    PFNGLPROGRAMBINARYEXTPROC programBinary;
+    PFNGLPROGRAMPARAMETERIEXTPROC programParameteri;
+
+    // KHR_parallel_shader_compile; when set, GL_COMPLETION_STATUS_KHR can be polled without blocking
+    PFNGLMAXSHADERCOMPILERTHREADSEXTPROC maxShaderCompilerThreads;
+
+    // compressed texture formats the driver can sample
+    bool s3tc;
+    bool s3tcSRGB;
+    bool bptc;
+
+    GLExtensions() : major(0), minor(0), texStorage3D(NULL), getProgramBinary(NULL), programBinary(NULL),
+        programParameteri(NULL), maxShaderCompilerThreads(NULL), s3tc(false), s3tcSRGB(false), bptc(false)
+    {
+    }
+
+    // call once after glad, with the loader glad used
+    void load(GLADloadproc loader)
+    {
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        extensions.clear();
+        for (GLint i = 0; i < count; i++)
+            extensions.push_back((const char*)glGetStringi(GL_EXTENSIONS, i));
+
+        if (atLeast(4, 2) || has("GL_ARB_texture_storage"))
+        {
+            texStorage3D = (PFNGLTEXSTORAGE3DEXTPROC)loader("glTexStorage3D");
+        }
+
+        if (atLeast(4, 1) || has("GL_ARB_get_program_binary"))
+        {
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            if (formats > 0)
+            {
+                getProgramBinary = (PFNGLGETPROGRAMBINARYEXTPROC)loader("glGetProgramBinary");
+                programBinary = (PFNGLPROGRAMBINARYEXTPROC)loader("glProgramBinary");
+                programParameteri = (PFNGLPROGRAMPARAMETERIEXTPROC)loader("glProgramParameteri");
+            }
+        }
+
+        if (has("GL_KHR_parallel_shader_compile"))
+            maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSEXTPROC)loader("glMaxShaderCompilerThreadsKHR");
+        else if (has("GL_ARB_parallel_shader_compile"))
+            maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSEXTPROC)loader("glMaxShaderCompilerThreadsARB");
+
+        s3tc = has("GL_EXT_texture_compression_s3tc");
+        s3tcSRGB = s3tc && (has("GL_EXT_texture_sRGB") || has("GL_EXT_texture_compression_s3tc_srgb"));
+        bptc = atLeast(4, 2) || has("GL_ARB_texture_compression_bptc");
+    }
+
+    bool atLeast(int wantMajor, int wantMinor) const
+    {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+
+    bool has(const char* name) const
+    {
+        for (size_t i = 0; i < extensions.size(); i++)
+        {
+            if (extensions[i] == name)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::string> extensions;
+};
+
+// the one set of entry points for the one GL context this program uses
+inline GLExtensions& glExt()
+{
+    static GLExtensions extensions;
+    return extensions;
+}
+
+#endif /* glExtensions_h */
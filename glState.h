@@ -0,0 +1,305 @@
+//
+//  glState.h
+//  3D-Shooter
+//
+//  Shadow copy of the GL binding and fixed-function state that skips calls which would change nothing.
+//
+
+#ifndef glState_h
+#define glState_h
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+const unsigned int GL_STATE_TEXTURE_UNITS = 16;
+
+class GLStateCache
+{
+public:
+    // calls forwarded to the driver vs calls dropped because the state was already set
+    unsigned long long issued;
+    unsigned long long skipped;
+
+    // work submitted through the draw wrappers below
+    unsigned long long drawCalls;
+    unsigned long long triangles;
+
+    GLStateCache() : issued(0), skipped(0), drawCalls(0), triangles(0), frameIssued(0), frameSkipped(0), frameStartIssued(0), frameStartSkipped(0),
+        frameDrawCalls(0), frameTriangles(0), frameStartDrawCalls(0), frameStartTriangles(0)
+    {
+        invalidate();
+    }
+
+    // forget everything we know, e.g. after code that talks to GL directly; the next call of each kind is issued
+    void invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+        {
+            textures[i] = UNKNOWN;
+            textureTargets[i] = UNKNOWN;
+            samplers[i] = UNKNOWN;
+        }
+        depthTest = UNKNOWN;
+        depthFunc = UNKNOWN;
+        depthMask = UNKNOWN;
+        colorMask = UNKNOWN;
+        cullFace = UNKNOWN;
+        blend = UNKNOWN;
+        blendSrc = UNKNOWN;
+        blendDst = UNKNOWN;
+    }
+
+    void useProgram(unsigned int id)
+    {
+        if (changed(program, id))
+            glUseProgram(id);
+    }
+
+    void bindVertexArray(unsigned int vao)
+    {
+        if (changed(vertexArray, vao))
+            glBindVertexArray(vao);
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if (changed(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // bind a texture to a unit, switching the active unit only when the binding really changes
+    void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+    {
+        if (unit >= GL_STATE_TEXTURE_UNITS)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(target, texture);
+            activeUnit = unit;
+            issued += 2;
+            return;
+        }
+        if (textures[unit] == texture && textureTargets[unit] == target)
+        {
+            skipped++;
+            return;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        textures[unit] = texture;
+        textureTargets[unit] = target;
+        issued++;
+    }
+
+    // sampler objects are bound per unit and don't touch the active unit
+    void bindSampler(unsigned int unit, unsigned int sampler)
+    {
+        if (unit >= GL_STATE_TEXTURE_UNITS)
+        {
+            glBindSampler(unit, sampler);
+            issued++;
+            return;
+        }
+        if (changed(samplers[unit], sampler))
+            glBindSampler(unit, sampler);
+    }
+
+    void setDepthTest(bool enabled)
+    {
+        if (changed(depthTest, enabled ? 1u : 0u))
+        {
+            if (enabled)
+                glEnable(GL_DEPTH_TEST);
+            else
+                glDisable(GL_DEPTH_TEST);
+        }
+    }
+
+    void setDepthFunc(GLenum func)
+    {
+        if (changed(depthFunc, func))
+            glDepthFunc(func);
+    }
+
+    void setDepthMask(bool write)
+    {
+        if (changed(depthMask, write ? 1u : 0u))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    // all four channels together; off for depth-only passes
+    void setColorMask(bool write)
+    {
+        if (changed(colorMask, write ? 1u : 0u))
+        {
+            GLboolean value = write ? GL_TRUE : GL_FALSE;
+            glColorMask(value, value, value, value);
+        }
+    }
+
+    // back faces only, with the default counter-clockwise front faces
+    void setCullFace(bool enabled)
+    {
+        if (changed(cullFace, enabled ? 1u : 0u))
+        {
+            if (enabled)
+                glEnable(GL_CULL_FACE);
+            else
+                glDisable(GL_CULL_FACE);
+        }
+    }
+
+    void setBlend(bool enabled)
+    {
+        if (changed(blend, enabled ? 1u : 0u))
+        {
+            if (enabled)
+                glEnable(GL_BLEND);
+            else
+                glDisable(GL_BLEND);
+        }
+    }
+
+    void setBlendFunc(GLenum src, GLenum dst)
+    {
+        if (blendSrc == src && blendDst == dst)
+        {
+            skipped++;
+            return;
+        }
+        glBlendFunc(src, dst);
+        blendSrc = src;
+        blendDst = dst;
+        issued++;
+    }
+
+    // draw calls are never skipped, they only go through here to be counted
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        glDrawElements(mode, count, type, indices);
+        countDraw(mode, count, 1);
+    }
+
+    // several index ranges of GL_TRIANGLES or GL_LINES in one call, counted as one draw
+    void multiDrawElements(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices, GLsizei drawCount)
+    {
+        glMultiDrawElements(mode, counts, type, indices, drawCount);
+        GLsizei total = 0;
+        for (GLsizei i = 0; i < drawCount; i++)
+            total += counts[i];
+        countDraw(mode, total, 1);
+    }
+
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+    {
+        glDrawElementsInstanced(mode, count, type, indices, instances);
+        countDraw(mode, count, instances);
+    }
+
+    void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+    {
+        glDrawArraysInstanced(mode, first, count, instances);
+        countDraw(mode, count, instances);
+    }
+
+    // mark a frame boundary so the counters of the frame that just finished can be reported
+    void beginFrame()
+    {
+        frameIssued = issued - frameStartIssued;
+        frameSkipped = skipped - frameStartSkipped;
+        frameDrawCalls = drawCalls - frameStartDrawCalls;
+        frameTriangles = triangles - frameStartTriangles;
+        frameStartIssued = issued;
+        frameStartSkipped = skipped;
+        frameStartDrawCalls = drawCalls;
+        frameStartTriangles = triangles;
+    }
+
+    unsigned long long getFrameIssued() const
+    {
+        return frameIssued;
+    }
+
+    unsigned long long getFrameSkipped() const
+    {
+        return frameSkipped;
+    }
+
+    unsigned long long getFrameDrawCalls() const
+    {
+        return frameDrawCalls;
+    }
+
+    unsigned long long getFrameTriangles() const
+    {
+        return frameTriangles;
+    }
+
+    void printStats() const
+    {
+        std::cout << "GL state calls last frame: " << frameIssued << " issued, " << frameSkipped << " skipped"
+            << " (total " << issued << " issued, " << skipped << " skipped)" << std::endl;
+        std::cout << "Draw calls last frame: " << frameDrawCalls << ", triangles: " << frameTriangles << std::endl;
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures[GL_STATE_TEXTURE_UNITS];
+    unsigned int textureTargets[GL_STATE_TEXTURE_UNITS];
+    unsigned int samplers[GL_STATE_TEXTURE_UNITS];
+    unsigned int depthTest;
+    unsigned int depthFunc;
+    unsigned int depthMask;
+    unsigned int colorMask;
+    unsigned int cullFace;
+    unsigned int blend;
+    unsigned int blendSrc;
+    unsigned int blendDst;
+
+    unsigned long long frameIssued;
+    unsigned long long frameSkipped;
+    unsigned long long frameStartIssued;
+    unsigned long long frameStartSkipped;
+    unsigned long long frameDrawCalls;
+    unsigned long long frameTriangles;
+    unsigned long long frameStartDrawCalls;
+    unsigned long long frameStartTriangles;
+
+    void countDraw(GLenum mode, GLsizei count, GLsizei instances)
+    {
+        drawCalls++;
+        if (mode == GL_TRIANGLES)
+            triangles += (unsigned long long)(count / 3) * instances;
+        else if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+            triangles += (unsigned long long)(count > 2 ? count - 2 : 0) * instances;
+    }
+
+    // record the new value and report whether a GL call is needed
+    bool changed(unsigned int& current, unsigned int value)
+    {
+        if (current == value)
+        {
+            skipped++;
+            return false;
+        }
+        current = value;
+        issued++;
+        return true;
+    }
+};
+
+// the one cache for the one GL context this program uses
+inline GLStateCache& glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+#endif /* glState_h */
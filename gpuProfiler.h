@@ -0,0 +1,265 @@
+//
+//  gpuProfiler.h
+//  3D-Shooter
+//
+//  GPU time of named scopes of the frame, measured with GL_TIME_ELAPSED queries. Each frame's
+//  queries are read GPU_PROFILER_FRAMES frames later, when the GPU has long finished them, so the
+//  CPU never waits for a result. Every scope keeps its last GPU_PROFILER_HISTORY frames for
+//  rolling min, average and max.
+//
+
+#ifndef gpuProfiler_h
+#define gpuProfiler_h
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cpuTrace.h"
+
+const unsigned int GPU_PROFILER_FRAMES = 4;     // frames in flight
+const unsigned int GPU_PROFILER_HISTORY = 120;  // frames the rolling statistics cover
+const unsigned int NO_GPU_SCOPE = ~0u;
+
+struct GpuScopeStats
+{
+    unsigned int samples;   // frames the scope ran in, at most GPU_PROFILER_HISTORY
+    float minimum;          // milliseconds
+    float average;
+    float maximum;
+};
+
+class GpuProfiler
+{
+public:
+    // frames whose queries were still not done after GPU_PROFILER_FRAMES frames and were dropped
+    unsigned long long droppedFrames;
+
+    GpuProfiler() : droppedFrames(0), frame(0), active(NO_GPU_SCOPE)
+    {
+    }
+
+    ~GpuProfiler()
+    {
+        for (unsigned int f = 0; f < GPU_PROFILER_FRAMES; f++)
+        {
+            if (!frames[f].queries.empty())
+                glDeleteQueries((GLsizei)frames[f].queries.size(), frames[f].queries.data());
+        }
+    }
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // returns the scope's index for begin(); adding a name twice returns the same scope
+    unsigned int addScope(const std::string& name)
+    {
+        for (size_t i = 0; i < scopes.size(); i++)
+        {
+            if (scopes[i].name == name)
+                return (unsigned int)i;
+        }
+        Scope scope;
+        scope.name = name;
+        scope.history.assign(GPU_PROFILER_HISTORY, 0.0f);
+        scope.next = 0;
+        scope.count = 0;
+        scopes.push_back(scope);
+        return (unsigned int)scopes.size() - 1;
+    }
+
+    // collect the results of the frame whose queries this frame reuses, then start recording
+    void beginFrame()
+    {
+        TRACE_SCOPE("read GPU timings");
+        end();
+        frame++;
+        Frame& current = frames[frame % GPU_PROFILER_FRAMES];
+        collect(current);
+        current.used = 0;
+    }
+
+    // time elapsed queries don't nest, so beginning a scope ends the one running; a scope may
+    // run several times a frame and gets the sum
+    void begin(unsigned int scope)
+    {
+        if (scope == active)
+            return;
+        end();
+        Frame& current = frames[frame % GPU_PROFILER_FRAMES];
+        if (current.used == current.queries.size())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            current.queries.push_back(query);
+            current.scopes.push_back(0);
+        }
+        current.scopes[current.used] = scope;
+        glBeginQuery(GL_TIME_ELAPSED, current.queries[current.used]);
+        current.used++;
+        active = scope;
+    }
+
+    void end()
+    {
+        if (active == NO_GPU_SCOPE)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        active = NO_GPU_SCOPE;
+    }
+
+    // wait for every outstanding frame, for a final report
+    void finish()
+    {
+        end();
+        for (unsigned int i = 1; i <= GPU_PROFILER_FRAMES; i++)
+        {
+            Frame& f = frames[(frame + i) % GPU_PROFILER_FRAMES];
+            if (f.used)
+                glFinish();
+            collect(f);
+            f.used = 0;
+        }
+    }
+
+    size_t scopeCount() const
+    {
+        return scopes.size();
+    }
+
+    const std::string& scopeName(unsigned int scope) const
+    {
+        return scopes[scope].name;
+    }
+
+    GpuScopeStats stats(unsigned int scope) const
+    {
+        const Scope& s = scopes[scope];
+        GpuScopeStats stats = { s.count, 0.0f, 0.0f, 0.0f };
+        if (s.count == 0)
+            return stats;
+        stats.minimum = 1e30f;
+        float sum = 0.0f;
+        for (unsigned int i = 0; i < s.count; i++)
+        {
+            float ms = s.history[i];
+            stats.minimum = std::min(stats.minimum, ms);
+            stats.maximum = std::max(stats.maximum, ms);
+            sum += ms;
+        }
+        stats.average = sum / s.count;
+        return stats;
+    }
+
+    // "name avg ms, ..." of the scopes that ran lately, e.g. for a window title
+    std::string summary() const
+    {
+        std::string text;
+        char number[32];
+        for (unsigned int i = 0; i < scopes.size(); i++)
+        {
+            GpuScopeStats s = stats(i);
+            if (s.samples == 0)
+                continue;
+            std::snprintf(number, sizeof(number), " %.2f", s.average);
+            text += (text.empty() ? "" : ", ") + scopes[i].name + number;
+        }
+        return "GPU ms: " + text;
+    }
+
+    void print() const
+    {
+        std::cout << "GPU time per frame (ms, min / avg / max of up to " << GPU_PROFILER_HISTORY << " frames):" << std::endl;
+        for (unsigned int i = 0; i < scopes.size(); i++)
+        {
+            GpuScopeStats s = stats(i);
+            if (s.samples == 0)
+                continue;
+            std::cout << "  " << scopes[i].name << ": " << s.minimum << " / " << s.average << " / " << s.maximum << " (" << s.samples << " frames)" << std::endl;
+        }
+        if (droppedFrames)
+            std::cout << "  " << droppedFrames << " frames dropped, their queries were not done in time" << std::endl;
+    }
+
+    // one line per scope: name, frames, min, avg and max in milliseconds
+    bool writeCsv(const char* path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "Could not write GPU profile " << path << std::endl;
+            return false;
+        }
+        file << "scope,frames,min_ms,avg_ms,max_ms\n";
+        for (unsigned int i = 0; i < scopes.size(); i++)
+        {
+            GpuScopeStats s = stats(i);
+            file << '"' << scopes[i].name << "\"," << s.samples << ',' << s.minimum << ',' << s.average << ',' << s.maximum << '\n';
+        }
+        return true;
+    }
+
+private:
+    struct Scope
+    {
+        std::string name;
+        std::vector<float> history;     // ring of per-frame milliseconds
+        unsigned int next;
+        unsigned int count;
+    };
+
+    // the queries one frame issued, reused GPU_PROFILER_FRAMES frames later
+    struct Frame
+    {
+        std::vector<GLuint> queries;
+        std::vector<unsigned int> scopes;
+        size_t used = 0;
+    };
+
+    std::vector<Scope> scopes;
+    Frame frames[GPU_PROFILER_FRAMES];
+    std::vector<GLuint64> totals;
+    std::vector<bool> ran;
+    unsigned long long frame;
+    unsigned int active;
+
+    // add a frame's times to the history; queries finish in order, so once the last one is
+    // available all of them are
+    void collect(Frame& f)
+    {
+        if (f.used == 0)
+            return;
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(f.queries[f.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            droppedFrames++;
+            return;
+        }
+        totals.assign(scopes.size(), 0);
+        ran.assign(scopes.size(), false);
+        for (size_t q = 0; q < f.used; q++)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(f.queries[q], GL_QUERY_RESULT, &nanoseconds);
+            totals[f.scopes[q]] += nanoseconds;
+            ran[f.scopes[q]] = true;
+        }
+        for (size_t i = 0; i < scopes.size(); i++)
+        {
+            if (!ran[i])
+                continue;
+            Scope& s = scopes[i];
+            s.history[s.next] = (float)(totals[i] / 1.0e6);
+            s.next = (s.next + 1) % GPU_PROFILER_HISTORY;
+            s.count = std::min(s.count + 1, GPU_PROFILER_HISTORY);
+        }
+    }
+};
+
+#endif /* gpuProfiler_h */
@@ -0,0 +1,93 @@
+//
+//  gpuProfilerOverlay.h
+//  3D-Shooter
+//
+//  The GPU profiler's scopes as bars in the top left corner of the screen, one row per scope in
+//  the order they were added: the average as a bright bar over the min to max range, against a
+//  dark track that stands for one 60 Hz frame. The numbers go to the window title.
+//
+
+#ifndef gpuProfilerOverlay_h
+#define gpuProfilerOverlay_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+#include "shader.h"
+#include "glState.h"
+#include "gpuProfiler.h"
+
+class GpuProfilerOverlay
+{
+public:
+    GpuProfilerOverlay() : shader("vertexShaderForProfiler.vs", "fragmentShaderForProfiler.fs"), VAO(0)
+    {
+        // the corners come from gl_VertexID, but core profile draws need some VAO bound
+        glGenVertexArrays(1, &VAO);
+    }
+
+    ~GpuProfilerOverlay()
+    {
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    void draw(const GpuProfiler& profiler)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if (viewport[2] <= 0 || viewport[3] <= 0)
+            return;
+        pixel = glm::vec2(2.0f / viewport[2], 2.0f / viewport[3]);
+
+        glState().setDepthTest(false);
+        shader.use();
+        glState().bindVertexArray(VAO);
+        static const glm::vec3 palette[] = {
+            glm::vec3(0.9f, 0.3f, 0.3f), glm::vec3(0.3f, 0.8f, 0.3f), glm::vec3(0.3f, 0.5f, 1.0f), glm::vec3(0.9f, 0.8f, 0.2f),
+            glm::vec3(0.8f, 0.4f, 0.9f), glm::vec3(0.2f, 0.8f, 0.8f), glm::vec3(1.0f, 0.6f, 0.2f), glm::vec3(0.7f, 0.7f, 0.7f)
+        };
+        for (unsigned int i = 0; i < profiler.scopeCount(); i++)
+        {
+            GpuScopeStats stats = profiler.stats(i);
+            float top = MARGIN + i * (ROW_HEIGHT + ROW_GAP);
+            glm::vec3 color = palette[i % (sizeof(palette) / sizeof(palette[0]))];
+            bar(0.0f, BUDGET_MS, top, ROW_HEIGHT, glm::vec3(0.1f));
+            if (stats.samples == 0)
+                continue;
+            bar(stats.minimum, stats.maximum, top, ROW_HEIGHT, color * 0.45f);
+            bar(0.0f, stats.average, top + 2.0f, ROW_HEIGHT - 4.0f, color);
+        }
+        glState().setDepthTest(true);
+    }
+
+private:
+    // pixels, from the top left corner of the viewport
+    static constexpr float MARGIN = 8.0f;
+    static constexpr float ROW_HEIGHT = 10.0f;
+    static constexpr float ROW_GAP = 4.0f;
+    static constexpr float BAR_WIDTH = 300.0f;
+    // milliseconds the full bar width stands for
+    static constexpr float BUDGET_MS = 1000.0f / 60.0f;
+
+    Shader shader;
+    GLuint VAO;
+    glm::vec2 pixel;    // size of one pixel in normalized device coordinates
+
+    // the part of a row between two times, clipped to the track and at least a pixel wide
+    void bar(float fromMs, float toMs, float top, float height, const glm::vec3& color)
+    {
+        static constexpr UniformName RECT = "rect";
+        static constexpr UniformName COLOR = "color";
+        float left = MARGIN + std::min(fromMs / BUDGET_MS, 1.0f) * BAR_WIDTH;
+        float right = MARGIN + std::min(toMs / BUDGET_MS, 1.0f) * BAR_WIDTH;
+        if (right - left < 1.0f)
+            right = left + 1.0f;
+        shader.setVec4(RECT, -1.0f + left * pixel.x, 1.0f - (top + height) * pixel.y, -1.0f + right * pixel.x, 1.0f - top * pixel.y);
+        shader.setVec3(COLOR, color);
+        glState().drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
+    }
+};
+
+#endif /* gpuProfilerOverlay_h */
@@ -0,0 +1,107 @@
+//
+//  instanceBuffer.h
+//  3D-Shooter
+//
+//  Per-instance transforms, tint colors and texture layers for glDrawElementsInstanced.
+//
+
+#ifndef instanceBuffer_h
+#define instanceBuffer_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "glState.h"
+
+#include <vector>
+#include <cstddef>
+
+// vertex attribute locations used by the instance data (0..2 are position, normal and uv)
+const unsigned int INSTANCE_MODEL_LOCATION = 3;     // mat4 takes locations 3, 4, 5 and 6
+const unsigned int INSTANCE_COLOR_LOCATION = 7;
+const unsigned int INSTANCE_LAYER_LOCATION = 8;
+
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::vec3 color;
+    float layer;            // texture array layer, negative for untextured
+};
+
+class InstanceBuffer
+{
+public:
+    unsigned int VBO;
+
+    InstanceBuffer() : VBO(0), capacity(0), count(0)
+    {
+    }
+
+    // make the vertex array read model matrix, color and layer per instance from this buffer
+    void attach(unsigned int VAO)
+    {
+        if (VBO == 0)
+            glGenBuffers(1, &VBO);
+
+        glState().bindVertexArray(VAO);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+        glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+        glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+        glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 1);
+        setFirstInstance(VAO, 0);
+        glState().bindVertexArray(0);
+    }
+
+    // point the vertex array's instance attributes at the given instance; GL 3.3 has no base instance
+    // parameter for draw calls, so batches that live further into the buffer are drawn this way
+    void setFirstInstance(unsigned int VAO, unsigned int first)
+    {
+        size_t base = first * sizeof(InstanceData);
+
+        glState().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+        // a mat4 attribute is fed as four vec4 columns
+        for (unsigned int i = 0; i < 4; i++)
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + sizeof(glm::vec4) * i));
+        glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, color)));
+        glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, layer)));
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // copy the instances to the GPU, growing the buffer only when it is too small
+    void upload(const std::vector<InstanceData>& instances)
+    {
+        if (VBO == 0)
+            glGenBuffers(1, &VBO);
+
+        count = (unsigned int)instances.size();
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (count > capacity)
+        {
+            capacity = count;
+            glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), instances.data(), GL_DYNAMIC_DRAW);
+        }
+        else if (count > 0)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    unsigned int getCount() const
+    {
+        return count;
+    }
+
+private:
+    unsigned int capacity;      // # of instances the VBO can hold
+    unsigned int count;         // # of instances uploaded last time
+};
+
+#endif /* instanceBuffer_h */
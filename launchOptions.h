@@ -0,0 +1,118 @@
+//
+//  launchOptions.h
+//  3D-Shooter
+//
+//  Command line switches for running the game without a window, e.g. on build servers.
+//
+
+#ifndef launchOptions_h
+#define launchOptions_h
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+struct LaunchOptions
+{
+    bool headless = false;          // render into an offscreen framebuffer, no window, no sound
+    unsigned int width = 0;         // framebuffer size, 0 keeps the default window size
+    unsigned int height = 0;
+    unsigned int frames = 60;       // frames rendered before a headless run exits
+    std::string output;             // PPM screenshot of the last headless frame, empty for none
+    std::string timedemo;           // input recording to replay as a benchmark
+    std::string record;             // file the input of this session is recorded to
+    bool textureCache = true;       // reuse decoded textures from earlier runs
+    bool shaderCache = true;        // reuse linked shader programs from earlier runs
+    std::string textureCompression = "none";  // none, bc1 or bc7
+    bool occlusionCulling = true;   // skip what the buildings hide
+    bool depthPyramid = false;      // show the occlusion culler's depth buffer, H toggles it
+    bool depthPrepass = false;      // depth-only pass before the lit pass, P toggles it
+    std::string shaderQuality = "high";     // low drops the specular terms of the lit shader
+    bool gpuOverlay = false;        // show the GPU profiler's bars, T toggles them
+    std::string gpuProfile;         // CSV the GPU profiler's scopes are written to on exit, empty for none
+    bool trace = true;              // record CPU trace scopes, see cpuTrace.h
+    std::string traceFile;          // Chrome trace JSON written on exit, and by F8, empty for trace.json on F8 only
+    double traceSeconds = 10.0;     // how far back a trace dump reaches
+    float hitchFactor = 2.0f;       // frames over this many times the median are dumped, 0 never
+    float hitchMinimumMs = 1000.0f / 60.0f;     // and only if they missed this too
+    std::string hitchDirectory = "hitches";     // where the flight recorder writes
+};
+
+inline void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [--headless] [--width N] [--height N] [--frames N] [--output file.ppm]"
+        << " [--timedemo file] [--record file]"
+        << " [--no-texture-cache] [--no-shader-cache] [--texture-compression none|bc1|bc7]"
+        << " [--no-occlusion-culling] [--depth-pyramid] [--depth-prepass]"
+        << " [--shader-quality low|high] [--gpu-overlay] [--gpu-profile file.csv]"
+        << " [--no-trace] [--trace file.json] [--trace-seconds N]"
+        << " [--hitch-factor F] [--hitch-min-ms N] [--hitch-dir dir]" << std::endl;
+}
+
+// returns false when the arguments are malformed or help was requested
+inline bool parseLaunchOptions(int argc, char** argv, LaunchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(arg, "--headless") == 0)
+            options.headless = true;
+        else if (std::strcmp(arg, "--width") == 0 && hasValue)
+            options.width = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        else if (std::strcmp(arg, "--height") == 0 && hasValue)
+            options.height = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        else if (std::strcmp(arg, "--frames") == 0 && hasValue)
+            options.frames = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        else if (std::strcmp(arg, "--output") == 0 && hasValue)
+            options.output = argv[++i];
+        else if (std::strcmp(arg, "--timedemo") == 0 && hasValue)
+            options.timedemo = argv[++i];
+        else if (std::strcmp(arg, "--record") == 0 && hasValue)
+            options.record = argv[++i];
+        else if (std::strcmp(arg, "--no-texture-cache") == 0)
+            options.textureCache = false;
+        else if (std::strcmp(arg, "--no-shader-cache") == 0)
+            options.shaderCache = false;
+        else if (std::strcmp(arg, "--texture-compression") == 0 && hasValue
+            && (std::strcmp(argv[i + 1], "none") == 0 || std::strcmp(argv[i + 1], "bc1") == 0 || std::strcmp(argv[i + 1], "bc7") == 0))
+            options.textureCompression = argv[++i];
+        else if (std::strcmp(arg, "--no-occlusion-culling") == 0)
+            options.occlusionCulling = false;
+        else if (std::strcmp(arg, "--depth-pyramid") == 0)
+            options.depthPyramid = true;
+        else if (std::strcmp(arg, "--depth-prepass") == 0)
+            options.depthPrepass = true;
+        else if (std::strcmp(arg, "--shader-quality") == 0 && hasValue
+            && (std::strcmp(argv[i + 1], "low") == 0 || std::strcmp(argv[i + 1], "high") == 0))
+            options.shaderQuality = argv[++i];
+        else if (std::strcmp(arg, "--gpu-overlay") == 0)
+            options.gpuOverlay = true;
+        else if (std::strcmp(arg, "--gpu-profile") == 0 && hasValue)
+            options.gpuProfile = argv[++i];
+        else if (std::strcmp(arg, "--no-trace") == 0)
+            options.trace = false;
+        else if (std::strcmp(arg, "--trace") == 0 && hasValue)
+            options.traceFile = argv[++i];
+        else if (std::strcmp(arg, "--trace-seconds") == 0 && hasValue)
+            options.traceSeconds = std::strtod(argv[++i], NULL);
+        else if (std::strcmp(arg, "--hitch-factor") == 0 && hasValue)
+            options.hitchFactor = std::strtof(argv[++i], NULL);
+        else if (std::strcmp(arg, "--hitch-min-ms") == 0 && hasValue)
+            options.hitchMinimumMs = std::strtof(argv[++i], NULL);
+        else if (std::strcmp(arg, "--hitch-dir") == 0 && hasValue)
+            options.hitchDirectory = argv[++i];
+        else
+        {
+            if (std::strcmp(arg, "--help") != 0)
+                std::cout << "Unknown or incomplete option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif /* launchOptions_h */
@@ -0,0 +1,270 @@
+//
+//  lightClusters.h
+//  3D-Shooter
+//
+//  Clustered forward lighting: the view frustum is cut into a grid of froxels, tiles on screen
+//  times exponential slices in depth, and every point light is binned on the CPU into the
+//  froxels its sphere of influence touches. The lights, the per-froxel ranges and the light
+//  index lists go to texture buffers, so a fragment only loops over the lights of its froxel.
+//
+
+#ifndef lightClusters_h
+#define lightClusters_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "shader.h"
+#include "glState.h"
+#include "frameData.h"
+
+// must match the grid the shader reads from FrameData.clusterSize
+const unsigned int CLUSTER_TILES_X = 16;
+const unsigned int CLUSTER_TILES_Y = 8;
+const unsigned int CLUSTER_SLICES = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+// light indices are 16 bit in the index buffer
+const unsigned int MAX_CLUSTER_LIGHTS = 65535;
+
+// a light's reach ends where it adds less than this to any colour channel, i.e. below what an
+// 8 bit framebuffer can show
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// distance at which 1 / (k_c + k_l d + k_q d^2), scaled by the brightest channel, drops to LIGHT_CUTOFF
+inline float lightRadius(float k_c, float k_l, float k_q, float brightest)
+{
+    float c = k_c - brightest / LIGHT_CUTOFF;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (k_q <= 0.0f)
+        return k_l > 0.0f ? -c / k_l : 1e30f;
+    return (-k_l + std::sqrt(k_l * k_l - 4.0f * k_q * c)) / (2.0f * k_q);
+}
+
+class LightClusters
+{
+public:
+    // of the last build()
+    unsigned int lightCount;
+    unsigned int visibleLightCount;
+    unsigned int indexCount;
+    unsigned int maxClusterLights;
+
+    // builds that found neither the lights nor the camera changed and kept the last grid
+    unsigned long long skippedBuilds;
+
+    LightClusters() : lightCount(0), visibleLightCount(0), indexCount(0), maxClusterLights(0), skippedBuilds(0), lightsChanged(true)
+    {
+        glGenBuffers(BUFFER_COUNT, buffers);
+        glGenTextures(BUFFER_COUNT, textures);
+        static const GLenum formats[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+        for (unsigned int i = 0; i < BUFFER_COUNT; i++)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+            glState().bindTexture(FIRST_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        ranges.resize(CLUSTER_COUNT * 2);
+    }
+
+    ~LightClusters()
+    {
+        glDeleteTextures(BUFFER_COUNT, textures);
+        glDeleteBuffers(BUFFER_COUNT, buffers);
+    }
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // point the shader's light samplers at the units the buffers live on
+    void attach(Shader& shader)
+    {
+        static constexpr UniformName LIGHTS = "lights";
+        static constexpr UniformName CLUSTERS = "clusters";
+        static constexpr UniformName LIGHT_INDICES = "lightIndices";
+        shader.use();
+        shader.setInt(LIGHTS, FIRST_UNIT + LIGHT_BUFFER);
+        shader.setInt(CLUSTERS, FIRST_UNIT + CLUSTER_BUFFER);
+        shader.setInt(LIGHT_INDICES, FIRST_UNIT + INDEX_BUFFER);
+    }
+
+    // replace the lights to bin, e.g. the ones that are switched on; light.radius bounds each
+    // light's influence, lights past MAX_CLUSTER_LIGHTS are dropped
+    void setLights(const std::vector<PointLightData>& active)
+    {
+        lights.clear();
+        for (size_t i = 0; i < active.size() && lights.size() < MAX_CLUSTER_LIGHTS; i++)
+            if (active[i].radius > 0.0f)
+                lights.push_back(active[i]);
+        lightsChanged = true;
+    }
+
+    // bin the lights for this camera, upload them and describe the grid in frame; a camera
+    // that didn't move and lights that didn't change keep last frame's buffers
+    void build(const glm::mat4& view, const glm::mat4& projection, FrameData& frame)
+    {
+        bool cameraChanged = view != lastView || projection != lastProjection;
+        lastView = view;
+        lastProjection = projection;
+
+        // near and far planes from the perspective matrix
+        float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+        float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+        float sliceScale = CLUSTER_SLICES / std::log(zFar / zNear);
+        float sliceBias = -std::log(zNear) * sliceScale;
+
+        frame.clusterSize = glm::uvec4(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, (unsigned int)lights.size());
+        frame.clusterDepth = glm::vec4(sliceScale, sliceBias, zNear, zFar);
+        for (unsigned int i = 0; i < BUFFER_COUNT; i++)
+            glState().bindTexture(FIRST_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+        if (!cameraChanged && !lightsChanged)
+        {
+            skippedBuilds++;
+            return;
+        }
+
+        // the froxel box each light touches, then a count per froxel
+        boxes.clear();
+        counts.assign(CLUSTER_COUNT, 0u);
+        visibleLightCount = 0;
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            LightBox box;
+            if (!lightBox(lights[i], view, projection, zNear, zFar, sliceScale, sliceBias, box))
+                continue;
+            box.light = (unsigned int)i;
+            boxes.push_back(box);
+            visibleLightCount++;
+            forEachCluster(box, [this](unsigned int cluster) { counts[cluster]++; });
+        }
+
+        // offsets from the counts, then the index lists in light order
+        indexCount = 0;
+        maxClusterLights = 0;
+        for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+        {
+            ranges[c * 2] = indexCount;
+            ranges[c * 2 + 1] = 0;
+            indexCount += counts[c];
+            maxClusterLights = std::max(maxClusterLights, counts[c]);
+        }
+        indices.resize(indexCount);
+        for (size_t b = 0; b < boxes.size(); b++)
+        {
+            unsigned short light = (unsigned short)boxes[b].light;
+            forEachCluster(boxes[b], [this, light](unsigned int cluster) {
+                indices[ranges[cluster * 2] + ranges[cluster * 2 + 1]++] = light;
+            });
+        }
+        lightCount = (unsigned int)lights.size();
+
+        if (lightsChanged)
+            upload(LIGHT_BUFFER, lights.data(), lights.size() * sizeof(PointLightData));
+        upload(CLUSTER_BUFFER, ranges.data(), ranges.size() * sizeof(unsigned int));
+        upload(INDEX_BUFFER, indices.data(), indices.size() * sizeof(unsigned short));
+        lightsChanged = false;
+    }
+
+private:
+    enum { LIGHT_BUFFER, CLUSTER_BUFFER, INDEX_BUFFER, BUFFER_COUNT };
+
+    // unit 0 holds the scene textures, unit 1 the depth pyramid overlay
+    static const unsigned int FIRST_UNIT = 2;
+
+    struct LightBox
+    {
+        unsigned int light;
+        unsigned int x0, x1, y0, y1, z0, z1;    // inclusive
+    };
+
+    GLuint buffers[BUFFER_COUNT];
+    GLuint textures[BUFFER_COUNT];
+    std::vector<PointLightData> lights;
+    std::vector<LightBox> boxes;
+    std::vector<unsigned int> counts;
+    std::vector<unsigned int> ranges;       // per froxel: first index, light count
+    std::vector<unsigned short> indices;
+    bool lightsChanged;
+    glm::mat4 lastView;
+    glm::mat4 lastProjection;
+
+    template <typename F>
+    static void forEachCluster(const LightBox& box, F f)
+    {
+        for (unsigned int z = box.z0; z <= box.z1; z++)
+            for (unsigned int y = box.y0; y <= box.y1; y++)
+                for (unsigned int x = box.x0; x <= box.x1; x++)
+                    f((z * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x);
+    }
+
+    static unsigned int slice(float depth, float sliceScale, float sliceBias)
+    {
+        int s = (int)std::floor(std::log(depth) * sliceScale + sliceBias);
+        return (unsigned int)std::min(std::max(s, 0), (int)CLUSTER_SLICES - 1);
+    }
+
+    static unsigned int tile(float ndc, unsigned int tiles)
+    {
+        int t = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return (unsigned int)std::min(std::max(t, 0), (int)tiles - 1);
+    }
+
+    // conservative froxel range of the light's sphere; false if it lies outside the frustum's depth range
+    static bool lightBox(const PointLightData& light, const glm::mat4& view, const glm::mat4& projection,
+        float zNear, float zFar, float sliceScale, float sliceBias, LightBox& box)
+    {
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float r = light.radius;
+        float nearest = -center.z - r;
+        float farthest = -center.z + r;
+        if (farthest < zNear || nearest > zFar)
+            return false;
+
+        box.z0 = slice(std::max(nearest, zNear), sliceScale, sliceBias);
+        box.z1 = slice(std::min(farthest, zFar), sliceScale, sliceBias);
+
+        // a sphere reaching past the near plane can cover any part of the screen
+        box.x0 = box.y0 = 0;
+        box.x1 = CLUSTER_TILES_X - 1;
+        box.y1 = CLUSTER_TILES_Y - 1;
+        if (nearest <= zNear)
+            return true;
+
+        // otherwise the projections of its bounding box's corners enclose it on screen
+        glm::vec2 lo(1e30f), hi(-1e30f);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 p = center + glm::vec3(corner & 1 ? r : -r, corner & 2 ? r : -r, corner & 4 ? r : -r);
+            glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            lo = glm::min(lo, ndc);
+            hi = glm::max(hi, ndc);
+        }
+        if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f)
+            return false;
+        box.x0 = tile(lo.x, CLUSTER_TILES_X);
+        box.x1 = tile(hi.x, CLUSTER_TILES_X);
+        box.y0 = tile(lo.y, CLUSTER_TILES_Y);
+        box.y1 = tile(hi.y, CLUSTER_TILES_Y);
+        return true;
+    }
+
+    // orphan the old storage so the driver never waits for frames still reading it
+    void upload(unsigned int buffer, const void* data, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), NULL, GL_STREAM_DRAW);
+        if (bytes)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif /* lightClusters_h */
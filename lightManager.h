@@ -0,0 +1,167 @@
+//
+//  lightManager.h
+//  3D-Shooter
+//
+//  Owns every light of the scene. Point lights are kept as parallel arrays; only the ones that
+//  are switched on and add something are handed to the clusters, and only after a switch or a
+//  property actually changed, so lights that are off cost the shader nothing.
+//
+
+#ifndef lightManager_h
+#define lightManager_h
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "frameData.h"
+#include "pointLight.h"
+#include "directionalLight.h"
+#include "lightClusters.h"
+
+class LightManager
+{
+public:
+    // point lights handed to the clusters by the last update()
+    unsigned int activeCount;
+
+    LightManager() : activeCount(0), pointLightsOn(true), ambientOn(true), diffuseOn(true), specularOn(true),
+        directional(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)), directionalOn(false), dirty(true)
+    {
+    }
+
+    // returns the light's index for the setters below
+    unsigned int addPointLight(const PointLight& light, bool enabled = true)
+    {
+        positions.push_back(light.position);
+        ambients.push_back(light.ambient);
+        diffuses.push_back(light.diffuse);
+        speculars.push_back(light.specular);
+        constants.push_back(light.k_c);
+        linears.push_back(light.k_l);
+        quadratics.push_back(light.k_q);
+        radii.push_back(light.radius);
+        enabledFlags.push_back(enabled);
+        dirty = true;
+        return (unsigned int)(positions.size() - 1);
+    }
+
+    void setDirectionalLight(const DirectionalLight& light)
+    {
+        directional = light;
+    }
+
+    size_t pointLightCount() const { return positions.size(); }
+    const glm::vec3& getPosition(unsigned int light) const { return positions[light]; }
+    const glm::vec3& getDiffuse(unsigned int light) const { return diffuses[light]; }
+    bool arePointLightsOn() const { return pointLightsOn; }
+
+    // the setters only mark the lights for upload when the value really changes,
+    // so calling them every frame with the same value costs nothing
+    void setPosition(unsigned int light, const glm::vec3& position)
+    {
+        if (positions[light] != position)
+        {
+            positions[light] = position;
+            dirty = true;
+        }
+    }
+
+    void setEnabled(unsigned int light, bool enabled)
+    {
+        if (enabledFlags[light] != enabled)
+        {
+            enabledFlags[light] = enabled;
+            dirty = true;
+        }
+    }
+
+    // switches for all point lights at once, as the number keys use them
+    void setPointLightsOn(bool on) { set(pointLightsOn, on); }
+    void setAmbientOn(bool on) { set(ambientOn, on); }
+    void setDiffuseOn(bool on) { set(diffuseOn, on); }
+    void setSpecularOn(bool on) { set(specularOn, on); }
+
+    void setDirectionalOn(bool on) { directionalOn = on; }
+
+    // re-collect the active point lights if anything changed, bin them for this camera and
+    // fill in the light part of frame
+    void update(LightClusters& clusters, const glm::mat4& view, const glm::mat4& projection, FrameData& frame)
+    {
+        if (dirty)
+        {
+            compact();
+            clusters.setLights(active);
+            dirty = false;
+        }
+        clusters.build(view, projection, frame);
+
+        DirectionalLightData& light = frame.directionalLight;
+        light.direction = directional.direction;
+        light.enabled = directionalOn ? 1.0f : 0.0f;
+        light.ambient = directionalOn ? directional.ambient : glm::vec3(0.0f);
+        light.diffuse = directionalOn ? directional.diffuse : glm::vec3(0.0f);
+        light.specular = directionalOn ? directional.specular : glm::vec3(0.0f);
+    }
+
+private:
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> ambients;
+    std::vector<glm::vec3> diffuses;
+    std::vector<glm::vec3> speculars;
+    std::vector<float> constants;
+    std::vector<float> linears;
+    std::vector<float> quadratics;
+    std::vector<float> radii;
+    std::vector<bool> enabledFlags;
+    std::vector<PointLightData> active;
+
+    bool pointLightsOn;
+    bool ambientOn;
+    bool diffuseOn;
+    bool specularOn;
+
+    DirectionalLight directional;
+    bool directionalOn;
+
+    bool dirty;
+
+    void set(bool& flag, bool value)
+    {
+        if (flag != value)
+        {
+            flag = value;
+            dirty = true;
+        }
+    }
+
+    // the lights that are on and have at least one term left, with the switched-off terms zeroed
+    void compact()
+    {
+        active.clear();
+        activeCount = 0;
+        if (!pointLightsOn || (!ambientOn && !diffuseOn && !specularOn))
+            return;
+        const glm::vec3 black(0.0f);
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            if (!enabledFlags[i])
+                continue;
+            PointLightData light;
+            light.position = positions[i];
+            light.ambient = ambientOn ? ambients[i] : black;
+            light.diffuse = diffuseOn ? diffuses[i] : black;
+            light.specular = specularOn ? speculars[i] : black;
+            if (light.ambient == black && light.diffuse == black && light.specular == black)
+                continue;
+            light.k_c = constants[i];
+            light.k_l = linears[i];
+            light.k_q = quadratics[i];
+            light.radius = radii[i];
+            active.push_back(light);
+        }
+        activeCount = (unsigned int)active.size();
+    }
+};
+
+#endif /* lightManager_h */
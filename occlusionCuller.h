@@ -0,0 +1,470 @@
+//
+//  occlusionCuller.h
+//  3D-Shooter
+//
+//  Software hierarchical-Z occlusion culling. A few large boxes close to the camera are
+//  rasterized into a small depth buffer on the CPU, split into horizontal bands across worker
+//  threads, four pixels at a time with SSE. A pyramid of 2x2 maximum depths is built over it, so
+//  any box can then be tested against the occluders with a handful of texel reads.
+//
+//  Both steps err towards visible: an occluder only writes pixels it covers completely, with the
+//  furthest depth it has inside that pixel, and a tested box compares its nearest corner against
+//  the furthest depth of every texel its screen rectangle touches.
+//
+
+#ifndef occlusionCuller_h
+#define occlusionCuller_h
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+#if defined(BOUNDS_TABLE_AVX) || defined(BOUNDS_TABLE_SSE)
+#define OCCLUSION_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+const unsigned int MAX_OCCLUDERS = 16;     // the largest on screen, the rest add little
+
+class OcclusionCuller
+{
+public:
+    // of the last render()
+    unsigned int occluderCount;
+
+    // threads = 0 picks one band per core, up to four
+    OcclusionCuller(unsigned int threads = 0) : occluderCount(0), ready(false), nearPlane(0.1f), farPlane(100.0f),
+        generation(0), pending(0), stopping(false)
+    {
+        depth.assign(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+        int w = OCCLUSION_WIDTH, h = OCCLUSION_HEIGHT;
+        while (w > 1 || h > 1)
+        {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            Level level = { w, h, std::vector<float>(w * h, 1.0f) };
+            pyramid.push_back(level);
+        }
+
+        if (threads == 0)
+            threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+        bands = threads;
+        for (unsigned int band = 1; band < bands; band++)
+            helpers.push_back(std::thread(&OcclusionCuller::work, this, band));
+    }
+
+    ~OcclusionCuller()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < helpers.size(); i++)
+            helpers[i].join();
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // rasterize the largest of the candidate world space boxes, which must be solid, and build the
+    // depth pyramid; test() answers against this until the next call
+    void render(const glm::mat4& view, const glm::mat4& projection, const std::vector<Bounds>& candidates)
+    {
+        viewProjection = projection * view;
+        nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+
+        // the boxes that look biggest from here hide the most
+        ranked.clear();
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            glm::vec3 center = (candidates[i].lower + candidates[i].upper) * 0.5f;
+            glm::vec3 toCenter = center - eye;
+            float size = glm::dot(candidates[i].upper - candidates[i].lower, candidates[i].upper - candidates[i].lower);
+            ranked.push_back(std::make_pair(size / std::max(glm::dot(toCenter, toCenter), 1e-4f), (unsigned int)i));
+        }
+        size_t count = std::min((size_t)MAX_OCCLUDERS, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), std::greater<std::pair<float, unsigned int> >());
+
+        occluders.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            Occluder occluder;
+            if (setup(candidates[ranked[i].second], eye, occluder))
+                occluders.push_back(occluder);
+        }
+        occluderCount = (unsigned int)occluders.size();
+
+        // every band clears and fills its own rows
+        if (bands > 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                generation++;
+                pending = bands - 1;
+            }
+            wake.notify_all();
+        }
+        rasterizeBand(0);
+        if (bands > 1)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return pending == 0; });
+        }
+
+        buildPyramid();
+        ready = true;
+    }
+
+    // false when the box is certainly hidden behind the occluders of the last render()
+    bool test(const Bounds& bounds) const
+    {
+        if (!ready)
+            return true;
+
+        glm::vec2 lower(1e30f), upper(-1e30f);
+        float nearest = 1e30f;
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec4 corner((c & 1) ? bounds.upper.x : bounds.lower.x, (c & 2) ? bounds.upper.y : bounds.lower.y,
+                (c & 4) ? bounds.upper.z : bounds.lower.z, 1.0f);
+            glm::vec4 clip = viewProjection * corner;
+            // corners behind the near plane would project mirrored
+            if (clip.w < nearPlane)
+                return true;
+            glm::vec3 screen = toScreen(clip);
+            lower = glm::min(lower, glm::vec2(screen));
+            upper = glm::max(upper, glm::vec2(screen));
+            nearest = std::min(nearest, screen.z);
+        }
+
+        int x0 = glm::clamp((int)std::floor(lower.x), 0, OCCLUSION_WIDTH - 1);
+        int x1 = glm::clamp((int)std::floor(upper.x), 0, OCCLUSION_WIDTH - 1);
+        int y0 = glm::clamp((int)std::floor(lower.y), 0, OCCLUSION_HEIGHT - 1);
+        int y1 = glm::clamp((int)std::floor(upper.y), 0, OCCLUSION_HEIGHT - 1);
+
+        // the finest level at which the rectangle touches at most 2x2 texels
+        int level = 0;
+        while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+            level++;
+
+        const float* texels = level == 0 ? depth.data() : pyramid[level - 1].depth.data();
+        int width = level == 0 ? OCCLUSION_WIDTH : pyramid[level - 1].width;
+        for (int y = y0 >> level; y <= y1 >> level; y++)
+        {
+            for (int x = x0 >> level; x <= x1 >> level; x++)
+            {
+                if (nearest <= texels[y * width + x] + DEPTH_EPSILON)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // the depth buffer with its pyramid levels stacked to its right, as 8-bit brightness that
+    // falls off with the log of the distance; rows go bottom to top like a GL texture
+    void debugImage(std::vector<unsigned char>& pixels, int& width, int& height) const
+    {
+        width = OCCLUSION_WIDTH + pyramid[0].width;
+        height = OCCLUSION_HEIGHT;
+        pixels.assign(width * height, 0);
+        copyLevel(depth.data(), OCCLUSION_WIDTH, OCCLUSION_HEIGHT, 0, 0, pixels, width);
+        int y = 0;
+        for (size_t i = 0; i < pyramid.size(); i++)
+        {
+            copyLevel(pyramid[i].depth.data(), pyramid[i].width, pyramid[i].height, OCCLUSION_WIDTH, y, pixels, width);
+            y += pyramid[i].height;
+        }
+    }
+
+private:
+    static constexpr float DEPTH_EPSILON = 1e-6f;
+
+    // a box projected to the screen: the edges of its outline, the depth planes of the faces
+    // towards the camera and the pixel rectangle it can touch. Both are offset by half a pixel,
+    // so a pixel passes when all of it is inside and gets the largest depth it has
+    struct Occluder
+    {
+        float edgeA[6], edgeB[6], edgeC[6];
+        int edgeCount;
+        float planeX[3], planeY[3], planeC[3];
+        int planeCount;
+        float farthest;
+        int minX, maxX, minY, maxY;
+    };
+
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<float> depth;   // maximum of the 2x2 texels below
+    };
+
+    std::vector<float> depth;       // OCCLUSION_WIDTH x OCCLUSION_HEIGHT window depths, 1 is the far plane
+    std::vector<Level> pyramid;
+    std::vector<Occluder> occluders;
+    std::vector<std::pair<float, unsigned int> > ranked;
+    bool ready;
+    glm::mat4 viewProjection;
+    float nearPlane;
+    float farPlane;
+
+    unsigned int bands;
+    std::vector<std::thread> helpers;
+    std::mutex mutex;
+    std::condition_variable wake;   // a new frame's bands are ready to rasterize, or we are stopping
+    std::condition_variable done;   // a helper finished its band
+    unsigned long long generation;
+    unsigned int pending;
+    bool stopping;
+
+    // pixel coordinates and window depth of a clip space point
+    static glm::vec3 toScreen(const glm::vec4& clip)
+    {
+        float w = 1.0f / clip.w;
+        return glm::vec3((clip.x * w * 0.5f + 0.5f) * OCCLUSION_WIDTH, (clip.y * w * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+            clip.z * w * 0.5f + 0.5f);
+    }
+
+    bool setup(const Bounds& bounds, const glm::vec3& eye, Occluder& occluder) const
+    {
+        glm::vec3 screen[8];
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec4 corner((c & 1) ? bounds.upper.x : bounds.lower.x, (c & 2) ? bounds.upper.y : bounds.lower.y,
+                (c & 4) ? bounds.upper.z : bounds.lower.z, 1.0f);
+            glm::vec4 clip = viewProjection * corner;
+            // GL clips what is in front of the near plane, leaving holes this would not have
+            if (clip.w < nearPlane)
+                return false;
+            screen[c] = toScreen(clip);
+        }
+
+        // the outline is the convex hull of the corners, counter-clockwise (Andrew's monotone chain)
+        int sorted[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        std::sort(sorted, sorted + 8, [&screen](int a, int b)
+            { return screen[a].x < screen[b].x || (screen[a].x == screen[b].x && screen[a].y < screen[b].y); });
+        int hull[16];
+        int n = 0;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            int start = n;
+            for (int k = 0; k < 8; k++)
+            {
+                const glm::vec3& p = screen[sorted[pass == 0 ? k : 7 - k]];
+                while (n >= start + 2 && cross(screen[hull[n - 2]], screen[hull[n - 1]], p) <= 0.0f)
+                    n--;
+                hull[n++] = sorted[pass == 0 ? k : 7 - k];
+            }
+            n--;    // the last point of each chain starts the other
+        }
+        if (n < 3)
+            return false;
+
+        float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+        occluder.edgeCount = n;
+        occluder.farthest = 0.0f;
+        for (int i = 0; i < n; i++)
+        {
+            const glm::vec3& p = screen[hull[i]];
+            const glm::vec3& q = screen[hull[(i + 1) % n]];
+            // E(x, y) = a x + b y + c is positive left of p -> q
+            float a = p.y - q.y, b = q.x - p.x;
+            occluder.edgeA[i] = a;
+            occluder.edgeB[i] = b;
+            occluder.edgeC[i] = p.x * q.y - p.y * q.x - 0.5f * (std::fabs(a) + std::fabs(b));
+            minX = std::min(minX, p.x);
+            maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y);
+            maxY = std::max(maxY, p.y);
+        }
+        for (int c = 0; c < 8; c++)
+            occluder.farthest = std::max(occluder.farthest, screen[c].z);
+
+        occluder.minX = std::max(0, (int)std::floor(minX));
+        occluder.maxX = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(maxX));
+        occluder.minY = std::max(0, (int)std::floor(minY));
+        occluder.maxY = std::min(OCCLUSION_HEIGHT - 1, (int)std::ceil(maxY));
+        if (occluder.minX > occluder.maxX || occluder.minY > occluder.maxY)
+            return false;
+
+        // window depth is affine in window x and y across a flat face. The faces towards the
+        // camera cover the outline, so at any point the real depth is at most the largest of
+        // their planes there, and never beyond the furthest corner
+        static const int faces[6][3] = {
+            { 0, 2, 4 }, { 1, 3, 5 },   // -x, +x
+            { 0, 1, 4 }, { 2, 3, 6 },   // -y, +y
+            { 0, 1, 2 }, { 4, 5, 6 }    // -z, +z
+        };
+        occluder.planeCount = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int face = eye[axis] < bounds.lower[axis] ? axis * 2 : eye[axis] > bounds.upper[axis] ? axis * 2 + 1 : -1;
+            if (face < 0)
+                continue;
+            const glm::vec3& p0 = screen[faces[face][0]];
+            const glm::vec3& p1 = screen[faces[face][1]];
+            const glm::vec3& p2 = screen[faces[face][2]];
+            float det = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+            if (std::fabs(det) < 1e-6f)
+                continue;   // edge on, covers nothing
+            float dzdx = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / det;
+            float dzdy = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) / det;
+            int k = occluder.planeCount++;
+            occluder.planeX[k] = dzdx;
+            occluder.planeY[k] = dzdy;
+            occluder.planeC[k] = p0.z - dzdx * p0.x - dzdy * p0.y + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+        }
+        if (occluder.planeCount == 0)
+        {
+            occluder.planeX[0] = 0.0f;
+            occluder.planeY[0] = 0.0f;
+            occluder.planeC[0] = occluder.farthest;
+            occluder.planeCount = 1;
+        }
+        return true;
+    }
+
+    static float cross(const glm::vec3& o, const glm::vec3& a, const glm::vec3& b)
+    {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    }
+
+    void work(unsigned int band)
+    {
+        unsigned long long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            rasterizeBand(band);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    void rasterizeBand(unsigned int band)
+    {
+        int first = OCCLUSION_HEIGHT * band / bands;
+        int last = OCCLUSION_HEIGHT * (band + 1) / bands;
+        std::fill(depth.begin() + first * OCCLUSION_WIDTH, depth.begin() + last * OCCLUSION_WIDTH, 1.0f);
+        for (size_t i = 0; i < occluders.size(); i++)
+        {
+            const Occluder& occluder = occluders[i];
+            for (int y = std::max(first, occluder.minY); y < std::min(last, occluder.maxY + 1); y++)
+                rasterizeRow(occluder, y);
+        }
+    }
+
+    void rasterizeRow(const Occluder& occluder, int y)
+    {
+        float* row = depth.data() + y * OCCLUSION_WIDTH;
+        float py = y + 0.5f;
+        float edgeRow[6], planeRow[3];
+        for (int e = 0; e < occluder.edgeCount; e++)
+            edgeRow[e] = occluder.edgeB[e] * py + occluder.edgeC[e];
+        for (int p = 0; p < occluder.planeCount; p++)
+            planeRow[p] = occluder.planeY[p] * py + occluder.planeC[p];
+
+        int x = occluder.minX;
+#if defined(OCCLUSION_CULLER_SSE)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 farthest = _mm_set1_ps(occluder.farthest);
+        for (; x + 4 <= occluder.maxX + 1; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (int e = 0; e < occluder.edgeCount; e++)
+            {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(occluder.edgeA[e]), px), _mm_set1_ps(edgeRow[e]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+            }
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(occluder.planeX[0]), px), _mm_set1_ps(planeRow[0]));
+            for (int p = 1; p < occluder.planeCount; p++)
+                z = _mm_max_ps(z, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(occluder.planeX[p]), px), _mm_set1_ps(planeRow[p])));
+            z = _mm_min_ps(z, farthest);
+            __m128 current = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_min_ps(current, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+        }
+#endif
+        // the pixels left over after the last group of four, or all of them without SIMD
+        for (; x <= occluder.maxX; x++)
+        {
+            float px = x + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < occluder.edgeCount && inside; e++)
+                inside = occluder.edgeA[e] * px + edgeRow[e] >= 0.0f;
+            if (!inside)
+                continue;
+            float z = occluder.planeX[0] * px + planeRow[0];
+            for (int p = 1; p < occluder.planeCount; p++)
+                z = std::max(z, occluder.planeX[p] * px + planeRow[p]);
+            row[x] = std::min(row[x], std::min(z, occluder.farthest));
+        }
+    }
+
+    void buildPyramid()
+    {
+        const float* below = depth.data();
+        int belowWidth = OCCLUSION_WIDTH, belowHeight = OCCLUSION_HEIGHT;
+        for (size_t i = 0; i < pyramid.size(); i++)
+        {
+            Level& level = pyramid[i];
+            for (int y = 0; y < level.height; y++)
+            {
+                // odd sizes repeat their last row and column
+                const float* row0 = below + (y * 2) * belowWidth;
+                const float* row1 = below + std::min(y * 2 + 1, belowHeight - 1) * belowWidth;
+                for (int x = 0; x < level.width; x++)
+                {
+                    int x0 = x * 2, x1 = std::min(x * 2 + 1, belowWidth - 1);
+                    level.depth[y * level.width + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+                }
+            }
+            below = level.depth.data();
+            belowWidth = level.width;
+            belowHeight = level.height;
+        }
+    }
+
+    void copyLevel(const float* texels, int width, int height, int left, int bottom, std::vector<unsigned char>& pixels, int stride) const
+    {
+        float range = std::log(farPlane / nearPlane);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                // window depth back to eye distance
+                float ndc = texels[y * width + x] * 2.0f - 1.0f;
+                float distance = 2.0f * nearPlane * farPlane / (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+                float shade = 1.0f - glm::clamp(std::log(distance / nearPlane) / range, 0.0f, 1.0f);
+                pixels[(bottom + y) * stride + left + x] = (unsigned char)(shade * 255.0f + 0.5f);
+            }
+        }
+    }
+};
+
+#endif /* occlusionCuller_h */
@@ -0,0 +1,102 @@
+//
+//  overdrawCounter.h
+//  3D-Shooter
+//
+//  Counts the fragments that pass the depth test, i.e. get shaded and written, with a
+//  GL_SAMPLES_PASSED query around the shaded passes. Queries are read a few frames late and
+//  only once available, so the CPU never waits for a result; one that is still not done then
+//  is dropped.
+//
+
+#ifndef overdrawCounter_h
+#define overdrawCounter_h
+
+#include <glad/glad.h>
+
+const unsigned int OVERDRAW_QUERIES = 4;    // frames in flight
+
+class OverdrawCounter
+{
+public:
+    // of the newest frame whose query has been read
+    unsigned long long samples;
+    // frames whose query was still not done after OVERDRAW_QUERIES frames and was dropped
+    unsigned long long droppedFrames;
+
+    OverdrawCounter() : samples(0), droppedFrames(0), next(0), active(false)
+    {
+        glGenQueries(OVERDRAW_QUERIES, queries);
+        for (unsigned int i = 0; i < OVERDRAW_QUERIES; i++)
+            pending[i] = false;
+    }
+
+    ~OverdrawCounter()
+    {
+        glDeleteQueries(OVERDRAW_QUERIES, queries);
+    }
+
+    OverdrawCounter(const OverdrawCounter&) = delete;
+    OverdrawCounter& operator=(const OverdrawCounter&) = delete;
+
+    // queries don't nest, so begin() and end() may each be called once per frame
+    void begin()
+    {
+        // the query being reused was issued OVERDRAW_QUERIES frames ago and is almost surely done
+        read(next, false);
+        glBeginQuery(GL_SAMPLES_PASSED, queries[next]);
+        active = true;
+    }
+
+    void end()
+    {
+        if (!active)
+            return;
+        glEndQuery(GL_SAMPLES_PASSED);
+        pending[next] = true;
+        next = (next + 1) % OVERDRAW_QUERIES;
+        active = false;
+    }
+
+    // wait for every outstanding query and read them oldest first, so samples belongs to the
+    // last frame
+    void finish()
+    {
+        for (unsigned int i = 0; i < OVERDRAW_QUERIES; i++)
+            read((next + i) % OVERDRAW_QUERIES, true);
+    }
+
+    // shaded fragments per pixel of a width x height framebuffer; 1 means no overdraw at all
+    // where the frame is covered
+    float perPixel(unsigned int width, unsigned int height) const
+    {
+        return width && height ? (float)samples / ((float)width * (float)height) : 0.0f;
+    }
+
+private:
+    GLuint queries[OVERDRAW_QUERIES];
+    bool pending[OVERDRAW_QUERIES];
+    unsigned int next;
+    bool active;
+
+    void read(unsigned int i, bool wait)
+    {
+        if (!pending[i])
+            return;
+        pending[i] = false;
+        if (!wait)
+        {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                droppedFrames++;
+                return;
+            }
+        }
+        GLuint64 result = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &result);
+        samples = result;
+    }
+};
+
+#endif /* overdrawCounter_h */
@@ -10,8 +10,9 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
-#include "shader.h"
+#include "lightClusters.h"
 
+// description of a point light; LightManager owns the lights and their switches
 class PointLight {
 public:
     glm::vec3 position;
@@ -21,9 +22,11 @@ public:
     float k_c;
     float k_l;
     float k_q;
+    float radius;   // the light fades to nothing at this distance
     int lightNumber;
 
-    PointLight(float posX, float posY, float posZ, float ambR, float ambG, float ambB, float diffR, float diffG, float diffB, float specR, float specG, float specB, float constant, float linear, float quadratic, int num) {
+    // a radius of 0 reaches as far as the attenuation leaves anything visible
+    PointLight(float posX, float posY, float posZ, float ambR, float ambG, float ambB, float diffR, float diffG, float diffB, float specR, float specG, float specB, float constant, float linear, float quadratic, int num, float range = 0.0f) {
 
         position = glm::vec3(posX, posY, posZ);
         ambient = glm::vec3(ambR, ambG, ambB);
@@ -33,89 +36,10 @@ public:
         k_l = linear;
         k_q = quadratic;
         lightNumber = num;
-    }
-    void setUpPointLight(Shader& lightingShader)
-    {
-        lightingShader.use();
-
-        if (lightNumber == 1) {
-            lightingShader.setVec3("pointLights[0].position", position);
-            lightingShader.setVec3("pointLights[0].ambient", ambient * ambientOn * isOn);
-            lightingShader.setVec3("pointLights[0].diffuse", diffuse * diffuseOn * isOn);
-            lightingShader.setVec3("pointLights[0].specular", specular * specularOn * isOn);
-            lightingShader.setFloat("pointLights[0].k_c", k_c);
-            lightingShader.setFloat("pointLights[0].k_l", k_l);
-            lightingShader.setFloat("pointLights[0].k_q", k_q);
-        }
 
-        else if (lightNumber == 2)
-        {
-            lightingShader.setVec3("pointLights[1].position", position);
-            lightingShader.setVec3("pointLights[1].ambient", ambient * ambientOn * isOn);
-            lightingShader.setVec3("pointLights[1].diffuse", diffuse * diffuseOn * isOn);
-            lightingShader.setVec3("pointLights[1].specular", specular * specularOn * isOn);
-            lightingShader.setFloat("pointLights[1].k_c", k_c);
-            lightingShader.setFloat("pointLights[1].k_l", k_l);
-            lightingShader.setFloat("pointLights[1].k_q", k_q);
-        }
-        else if (lightNumber == 3)
-        {
-            lightingShader.setVec3("pointLights[2].position", position);
-            lightingShader.setVec3("pointLights[2].ambient", ambient * ambientOn * isOn);
-            lightingShader.setVec3("pointLights[2].diffuse", diffuse * diffuseOn * isOn);
-            lightingShader.setVec3("pointLights[2].specular", specular * specularOn * isOn);
-            lightingShader.setFloat("pointLights[2].k_c", k_c);
-            lightingShader.setFloat("pointLights[2].k_l", k_l);
-            lightingShader.setFloat("pointLights[2].k_q", k_q);
-        }
-        else
-        {
-            lightingShader.setVec3("pointLights[3].position", position);
-            lightingShader.setVec3("pointLights[3].ambient", ambient * ambientOn * isOn);
-            lightingShader.setVec3("pointLights[3].diffuse", diffuse * diffuseOn * isOn);
-            lightingShader.setVec3("pointLights[3].specular", specular * specularOn * isOn);
-            lightingShader.setFloat("pointLights[3].k_c", k_c);
-            lightingShader.setFloat("pointLights[3].k_l", k_l);
-            lightingShader.setFloat("pointLights[3].k_q", k_q);
-        }
-    }
-    void turnOff()
-    {
-        isOn = 0.0;
-    }
-    void turnOn()
-    {
-        isOn = 1.0;
-    }
-    void turnAmbientOn()
-    {
-        ambientOn = 1.0;
-    }
-    void turnAmbientOff()
-    {
-        ambientOn = 0.0;
-    }
-    void turnDiffuseOn()
-    {
-        diffuseOn = 1.0;
-    }
-    void turnDiffuseOff()
-    {
-        diffuseOn = 0.0;
-    }
-    void turnSpecularOn()
-    {
-        specularOn = 1.0;
-    }
-    void turnSpecularOff()
-    {
-        specularOn = 0.0;
+        glm::vec3 brightest = glm::max(ambient, glm::max(diffuse, specular));
+        radius = range > 0.0f ? range : lightRadius(k_c, k_l, k_q, glm::max(brightest.r, glm::max(brightest.g, brightest.b)));
     }
-private:
-    float ambientOn = 1.0;
-    float diffuseOn = 1.0;
-    float specularOn = 1.0;
-    float isOn = 1.0;
 };
 
 #endif /* pointLight_h */
@@ -0,0 +1,192 @@
+//
+//  programCache.h
+//  3D-Shooter
+//
+//  On-disk cache of linked shader programs. Each program gets one file holding the driver's
+//  binary and a hash of its preprocessed sources and the driver's vendor, renderer and version
+//  strings; new sources or another driver no longer match and the program is compiled again.
+//  The driver may still refuse a binary, e.g. after an update that kept its version string, in
+//  which case the caller simply compiles from source.
+//
+
+#ifndef programCache_h
+#define programCache_h
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "glExtensions.h"
+#include "mappedFile.h"
+#include "textureCache.h"   // hashBytes
+
+// bump when the file layout changes, so old cache files are rebuilt
+const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+    char magic[4];                  // "PGC1"
+    unsigned int version;
+    unsigned long long sourceHash;  // FNV-1a of the sources and the driver strings
+    unsigned int format;            // binary format the driver reported
+    unsigned int size;              // bytes of binary after the header
+};
+
+class ProgramCache
+{
+public:
+    // programs served from the cache, linked from source and stored, and binaries the driver refused
+    unsigned int loaded;
+    unsigned int stored;
+    unsigned int rejected;
+
+    ProgramCache() : loaded(0), stored(0), rejected(0)
+    {
+    }
+
+    // an empty directory disables the cache; needs glExt() loaded
+    void open(const std::string& cacheDirectory)
+    {
+        directory = cacheDirectory;
+        if (!isEnabled())
+            return;
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        const char* vendor = (const char*)glGetString(GL_VENDOR);
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        const char* version = (const char*)glGetString(GL_VERSION);
+        driver = std::string(vendor ? vendor : "") + "\n" + (renderer ? renderer : "") + "\n" + (version ? version : "");
+    }
+
+    bool isEnabled() const
+    {
+        return !directory.empty() && glExt().programBinary != NULL;
+    }
+
+    // identifies what a program was built from; name picks the cache file, e.g. the source paths
+    // and defines, so a program that changes replaces its old entry instead of adding one
+    unsigned long long hash(const std::vector<std::string>& sources) const
+    {
+        std::string key = driver;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            key += '\0';
+            key += sources[i];
+        }
+        return hashBytes((const unsigned char*)key.data(), key.size());
+    }
+
+    // a linked program from the cache entry of name, or 0 when there is none, it is stale or the
+    // driver refuses it
+    GLuint load(const std::string& name, unsigned long long sourceHash)
+    {
+        MappedFile file;
+        if (!isEnabled() || !file.open(cachePath(name).c_str()))
+            return 0;
+
+        ProgramCacheHeader header;
+        if (file.size() < sizeof(header))
+            return 0;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "PGC1", 4) != 0 || header.version != PROGRAM_CACHE_VERSION || header.sourceHash != sourceHash
+            || file.size() < sizeof(header) + header.size)
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glExt().programBinary(program, header.format, file.data() + sizeof(header), (GLsizei)header.size);
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(program);
+            rejected++;
+            return 0;
+        }
+        loaded++;
+        return program;
+    }
+
+    // ask the driver to keep the binary of a program about to be linked
+    void prepare(GLuint program) const
+    {
+        if (isEnabled())
+            glExt().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // store a successfully linked program; written to a temporary file first so a crash never
+    // leaves a torn entry
+    bool store(const std::string& name, unsigned long long sourceHash, GLuint program)
+    {
+        if (!isEnabled())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<unsigned char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glExt().getProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        ProgramCacheHeader header;
+        std::memcpy(header.magic, "PGC1", 4);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.sourceHash = sourceHash;
+        header.format = format;
+        header.size = (unsigned int)written;
+
+        std::string path = cachePath(name);
+        std::string temporary = path + ".tmp";
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+            return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+            && std::fwrite(binary.data(), 1, (size_t)written, file) == (size_t)written;
+        ok = std::fclose(file) == 0 && ok;
+        if (ok)
+        {
+            std::remove(path.c_str());
+            ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+        if (!ok)
+            std::remove(temporary.c_str());
+        if (ok)
+            stored++;
+        return ok;
+    }
+
+private:
+    std::string directory;
+    std::string driver;
+
+    std::string cachePath(const std::string& name) const
+    {
+        char file[32];
+        unsigned long long nameHash = hashBytes((const unsigned char*)name.data(), name.size());
+        std::snprintf(file, sizeof(file), "%016llx", nameHash);
+        return directory + "/" + file + ".progcache";
+    }
+};
+
+// the one cache for the one GL context this program uses
+inline ProgramCache& programCache()
+{
+    static ProgramCache cache;
+    return cache;
+}
+
+#endif /* programCache_h */
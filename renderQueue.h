@@ -0,0 +1,576 @@
+//
+//  renderQueue.h
+//  3D-Shooter
+//
+//  Collects draw items for a frame, sorts them by a packed 64-bit state key and
+//  draws runs of items that share program and mesh as one instanced batch. Textures are
+//  layers of one array bound for the whole flush, so each item picks its own layer. Items and
+//  the parts of baked meshes outside the view frustum are dropped before anything is drawn, and
+//  with an occlusion culler so are those hidden behind the parts marked as occluders. An optional
+//  depth pre-pass lays down the opaque depths first, so the lit pass shades each pixel once.
+//
+
+#ifndef renderQueue_h
+#define renderQueue_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+
+#include "shader.h"
+#include "glState.h"
+#include "instanceBuffer.h"
+#include "cpuTrace.h"
+#include "frustum.h"
+#include "gpuProfiler.h"
+#include "occlusionCuller.h"
+#include "overdrawCounter.h"
+
+#include <algorithm>
+
+// passes are drawn in this order
+enum RenderPass {
+    PASS_OPAQUE = 0,        // sorted front to back inside each state group
+    PASS_BACKGROUND = 1,    // on the far plane, only where nothing opaque was drawn; closed meshes
+                            // with counter-clockwise outer faces, their back faces are culled
+    PASS_TRANSPARENT = 2    // sorted back to front
+};
+
+// draw key layout, most significant bits first:
+//   63..62 pass | 61..56 program | 55..46 mesh | 45..22 depth | 21..0 unused
+const int KEY_PASS_SHIFT = 62;
+const int KEY_PROGRAM_SHIFT = 56;
+const int KEY_MESH_SHIFT = 46;
+const int KEY_DEPTH_SHIFT = 22;
+const unsigned long long KEY_DEPTH_MAX = (1ull << 24) - 1;
+const float KEY_DEPTH_RANGE = 100.0f;      // matches the far plane of the projection
+
+// texture layer of items drawn without a texture
+const int NO_TEXTURE = -1;
+
+struct Mesh
+{
+    unsigned int VAO;
+    GLenum mode;            // primitive type
+    unsigned int count;     // # of indices, or # of vertices when not indexed
+    bool indexed;
+    glm::vec3 center;       // object space center, used for depth sorting
+    Bounds bounds;          // object space box, used for culling
+    bool baked;             // already in world space with per-vertex colors and layers, see staticBatch.h
+    unsigned int firstPart; // baked meshes are drawn as index ranges, each culled on its own
+    unsigned int partCount;
+};
+
+// index range of a baked mesh
+struct MeshPart
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    bool occluder;          // solid box that hides what is behind it
+};
+
+struct DrawItem
+{
+    unsigned long long key;
+    unsigned int pass;
+    unsigned int program;
+    unsigned int mesh;
+    int layer;              // texture array layer, NO_TEXTURE draws untextured
+    glm::mat4 model;
+    glm::vec3 color;        // ambient and diffuse material color
+};
+
+class RenderQueue
+{
+public:
+    // draw statistics of the last flush
+    unsigned int itemCount;
+    unsigned int visibleItemCount;
+    unsigned int visiblePartCount;      // of getPartCount() baked mesh parts
+    unsigned int occludedItemCount;     // in the frustum but hidden, not counted as visible
+    unsigned int occludedPartCount;
+    unsigned int batchCount;
+
+    RenderQueue() : itemCount(0), visibleItemCount(0), visiblePartCount(0), occludedItemCount(0), occludedPartCount(0), batchCount(0),
+        textureArray(0), occlusionCuller(NULL), depthPrepass(NULL), depthPrepassSetUp(NULL), overdrawCounter(NULL), gpuProfiler(NULL), prepassScope(0)
+    {
+    }
+
+    // cull against the occluder parts too; NULL turns occlusion culling off
+    void setOcclusionCuller(OcclusionCuller* culler)
+    {
+        occlusionCuller = culler;
+    }
+
+    // draw the opaque pass with this program first, depth only, then shade it with GL_EQUAL depth
+    // tests; NULL draws it once with GL_LESS. The program must position vertices exactly like the
+    // opaque programs do, see vertexShaderForDepth.vs
+    void setDepthPrepass(Shader* shader)
+    {
+        depthPrepass = shader;
+    }
+
+    // count the fragments the shaded passes write, NULL for none
+    void setOverdrawCounter(OverdrawCounter* counter)
+    {
+        overdrawCounter = counter;
+    }
+
+    // time the depth pre-pass and each pass on the GPU, NULL for not at all
+    void setProfiler(GpuProfiler* profiler)
+    {
+        gpuProfiler = profiler;
+        if (!profiler)
+            return;
+        prepassScope = profiler->addScope("depth prepass");
+        passScopes[PASS_OPAQUE] = profiler->addScope("opaque");
+        passScopes[PASS_BACKGROUND] = profiler->addScope("sky");
+        passScopes[PASS_TRANSPARENT] = profiler->addScope("transparent");
+    }
+
+    // time the opaque draws of a mesh under a scope of its own instead of "opaque"
+    void setMeshScope(unsigned int mesh, unsigned int scope)
+    {
+        meshScopes.resize(meshes.size(), NO_GPU_SCOPE);
+        meshScopes[mesh] = scope;
+    }
+
+    // the array textured items sample; bound to unit 0 for every flush
+    void setTextureArray(GLuint texture)
+    {
+        textureArray = texture;
+    }
+
+    // programs must declare the instance attributes and the 'instanced' uniform; the queue sets it
+    // and the material once and leaves them, see invalidateProgram()
+    unsigned int addProgram(Shader& shader)
+    {
+        programs.push_back(&shader);
+        programSetUp.push_back(false);
+        return (unsigned int)programs.size() - 1;
+    }
+
+    // code that draws with a queue program on its own, e.g. Sphere::drawSphere, changes its
+    // 'instanced' and material uniforms; the next flush sets them again
+    void invalidateProgram(unsigned int program)
+    {
+        programSetUp[program] = false;
+    }
+
+    // bounds default to the unit cube the scene's cubes are built from
+    unsigned int addMesh(unsigned int VAO, GLenum mode, unsigned int count, bool indexed, const Bounds& bounds = { glm::vec3(0.0f), glm::vec3(1.0f) })
+    {
+        Mesh mesh = { VAO, mode, count, indexed, (bounds.lower + bounds.upper) * 0.5f, bounds, false, 0, 0 };
+        meshes.push_back(mesh);
+        meshFirstInstance.push_back(0);
+        instances.attach(VAO);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    // a pre-transformed index buffer; its VAO supplies its own identity instance, vertex colors
+    // and layers, so items using it are submitted with an identity model, a white color and
+    // NO_TEXTURE. Its ranges are added with addMeshPart() right after
+    unsigned int addBakedMesh(unsigned int VAO, GLenum mode)
+    {
+        Mesh mesh = { VAO, mode, 0, true, glm::vec3(0.0f), { glm::vec3(1e30f), glm::vec3(-1e30f) }, true, (unsigned int)parts.size(), 0 };
+        meshes.push_back(mesh);
+        meshFirstInstance.push_back(0);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    // one index range of the last baked mesh, with its world space box. Occluders must fill their
+    // box, like the buildings, so the culler can use it to hide other items and parts
+    void addMeshPart(unsigned int mesh, unsigned int firstIndex, unsigned int indexCount, const Bounds& bounds, bool occluder = false)
+    {
+        Mesh& baked = meshes[mesh];
+        if (baked.firstPart + baked.partCount != parts.size())
+        {
+            std::cerr << "ERROR::RENDER_QUEUE::PARTS_MUST_FOLLOW_THEIR_MESH" << std::endl;
+            return;
+        }
+        MeshPart part = { firstIndex, indexCount, occluder };
+        parts.push_back(part);
+        partBounds.add(bounds);
+        baked.partCount++;
+        baked.count += indexCount;
+        baked.bounds = mergeBounds(baked.bounds, bounds);
+        baked.center = (baked.bounds.lower + baked.bounds.upper) * 0.5f;
+    }
+
+    unsigned int getPartCount() const
+    {
+        return (unsigned int)parts.size();
+    }
+
+    // start a new frame; the view matrix gives the depth used for sorting, projection * view the
+    // frustum items are culled against
+    void begin(const glm::mat4& view, const glm::mat4& projection)
+    {
+        this->view = view;
+        this->projection = projection;
+        frustum.extract(projection * view);
+        items.clear();
+        itemBounds.clear();
+    }
+
+    void submit(unsigned int pass, unsigned int program, unsigned int mesh, int layer, const glm::mat4& model, const glm::vec3& color)
+    {
+        DrawItem item;
+        item.pass = pass;
+        item.program = program;
+        item.mesh = mesh;
+        item.layer = layer;
+        item.model = model;
+        item.color = color;
+
+        // distance along the view direction of the object's center
+        glm::vec4 center = view * model * glm::vec4(meshes[mesh].center, 1.0f);
+        float depth = glm::clamp(-center.z / KEY_DEPTH_RANGE, 0.0f, 1.0f);
+        unsigned long long depthBits = (unsigned long long)(depth * KEY_DEPTH_MAX);
+        if (pass == PASS_TRANSPARENT)
+            depthBits = KEY_DEPTH_MAX - depthBits;
+
+        item.key = ((unsigned long long)pass << KEY_PASS_SHIFT)
+            | ((unsigned long long)(program & 0x3F) << KEY_PROGRAM_SHIFT)
+            | ((unsigned long long)(mesh & 0x3FF) << KEY_MESH_SHIFT)
+            | (depthBits << KEY_DEPTH_SHIFT);
+        items.push_back(item);
+        itemBounds.add(transformBounds(meshes[mesh].bounds, model));
+    }
+
+    // sort, merge and draw everything submitted since begin()
+    void flush()
+    {
+        TRACE_SCOPE("flush render queue");
+        itemCount = (unsigned int)items.size();
+        visibleItemCount = 0;
+        visiblePartCount = 0;
+        occludedItemCount = 0;
+        occludedPartCount = 0;
+        batchCount = 0;
+        if (items.empty())
+            return;
+
+        // only what is in view goes on to sorting, instance upload and drawing
+        {
+            TRACE_SCOPE("cull");
+            order.clear();
+            itemBounds.cull(frustum, order);
+            cullParts();
+            if (occlusionCuller)
+                cullOccluded();
+        }
+        visibleItemCount = (unsigned int)order.size();
+        if (order.empty())
+            return;
+
+        TRACE_SCOPE("sort and draw");
+        sortItems();
+
+        // instances are laid out in draw order so every batch is a contiguous range; culled items
+        // get none, so only the visible ones are uploaded
+        instanceData.resize(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const DrawItem& item = items[order[i]];
+            instanceData[i].model = item.model;
+            instanceData[i].color = item.color;
+            instanceData[i].layer = (float)item.layer;
+        }
+        instances.upload(instanceData);
+
+        if (textureArray != 0)
+            glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, textureArray);
+
+        // extend each batch while the draw state stays the same; the key only orders items, the
+        // merge compares the real values so key bit truncation can never merge wrong draws
+        batches.clear();
+        size_t first = 0;
+        while (first < order.size())
+        {
+            size_t last = first + 1;
+            while (last < order.size() && sameState(items[order[first]], items[order[last]]))
+                last++;
+            Batch batch = { first, last };
+            batches.push_back(batch);
+            first = last;
+        }
+
+        if (depthPrepass)
+            drawDepthPrepass();
+
+        if (overdrawCounter)
+            overdrawCounter->begin();
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            const DrawItem& head = items[order[batches[b].first]];
+            setPassState(head.pass);
+            if (gpuProfiler)
+                gpuProfiler->begin(scopeOf(head));
+
+            TRACE_SCOPE("draw batch");
+            Shader& shader = *programs[head.program];
+            shader.use();
+            // once per program, on its first draw: before that it may still be compiling
+            if (!programSetUp[head.program])
+            {
+                static constexpr UniformName MATERIAL_AMBIENT = "material.ambient";
+                static constexpr UniformName MATERIAL_DIFFUSE = "material.diffuse";
+                static constexpr UniformName MATERIAL_SPECULAR = "material.specular";
+                static constexpr UniformName MATERIAL_SHININESS = "material.shininess";
+                static constexpr UniformName INSTANCED = "instanced";
+
+                // the per-instance color tints a white material
+                shader.setVec3(MATERIAL_AMBIENT, glm::vec3(1.0f, 1.0f, 1.0f));
+                shader.setVec3(MATERIAL_DIFFUSE, glm::vec3(1.0f, 1.0f, 1.0f));
+                shader.setVec3(MATERIAL_SPECULAR, glm::vec3(0.5f, 0.5f, 0.5f));
+                shader.setFloat(MATERIAL_SHININESS, 32.0f);
+                shader.setBool(INSTANCED, true);
+                programSetUp[head.program] = true;
+            }
+
+            if (drawBatch(batches[b]))
+                batchCount++;
+        }
+        if (overdrawCounter)
+            overdrawCounter->end();
+        if (gpuProfiler)
+            gpuProfiler->end();
+        glState().setDepthFunc(GL_LESS);
+        glState().setDepthMask(true);
+        glState().setCullFace(false);
+    }
+
+private:
+    // run of items in draw order that share pass, program and mesh
+    struct Batch
+    {
+        size_t first;
+        size_t last;
+    };
+
+    std::vector<Shader*> programs;
+    std::vector<Mesh> meshes;
+    std::vector<unsigned int> meshFirstInstance;   // instance the mesh's VAO currently points at
+    std::vector<DrawItem> items;
+    BoundsTable itemBounds;                        // world space box of each item
+    std::vector<MeshPart> parts;                   // index ranges of the baked meshes
+    BoundsTable partBounds;                        // and their world space boxes
+    std::vector<unsigned int> visibleParts;
+    std::vector<bool> partVisible;
+    std::vector<GLsizei> rangeCounts;              // index ranges of one glMultiDrawElements
+    std::vector<const void*> rangeOffsets;
+    Frustum frustum;
+    std::vector<unsigned int> order;               // visible item indices in draw order
+    std::vector<unsigned int> scratch;
+    std::vector<InstanceData> instanceData;
+    std::vector<bool> programSetUp;                // per program: material and 'instanced' uniforms set
+    std::vector<Batch> batches;
+    std::vector<std::pair<float, unsigned int> > partOrder;   // view depth and index of visible parts
+    InstanceBuffer instances;
+    GLuint textureArray;
+    OcclusionCuller* occlusionCuller;
+    Shader* depthPrepass;
+    Shader* depthPrepassSetUp;                     // the prepass program 'instanced' was set for
+    OverdrawCounter* overdrawCounter;
+    GpuProfiler* gpuProfiler;
+    unsigned int prepassScope;
+    unsigned int passScopes[PASS_TRANSPARENT + 1];
+    std::vector<unsigned int> meshScopes;          // per mesh: scope of its opaque draws or NO_GPU_SCOPE
+    std::vector<Bounds> occluderBounds;
+    glm::mat4 view;
+    glm::mat4 projection;
+
+    unsigned int scopeOf(const DrawItem& item) const
+    {
+        if (item.pass == PASS_OPAQUE && item.mesh < meshScopes.size() && meshScopes[item.mesh] != NO_GPU_SCOPE)
+            return meshScopes[item.mesh];
+        return passScopes[item.pass];
+    }
+
+    static bool sameState(const DrawItem& a, const DrawItem& b)
+    {
+        return a.pass == b.pass && a.program == b.program && a.mesh == b.mesh;
+    }
+
+    // depth state of the shaded passes
+    void setPassState(unsigned int pass)
+    {
+        if (pass == PASS_OPAQUE)
+        {
+            glState().setDepthFunc(depthPrepass ? GL_EQUAL : GL_LESS);
+            glState().setDepthMask(depthPrepass == NULL);
+        }
+        else
+        {
+            // the background is drawn at the far plane, so it needs GL_LEQUAL to pass the cleared
+            // depth, and its back faces would land on the same depth as its front faces
+            glState().setDepthFunc(pass == PASS_BACKGROUND ? GL_LEQUAL : GL_LESS);
+            glState().setDepthMask(false);
+        }
+        glState().setCullFace(pass == PASS_BACKGROUND);
+    }
+
+    // the opaque batches with color writes off; batches are sorted by pass, so they come first
+    void drawDepthPrepass()
+    {
+        TRACE_SCOPE("depth prepass");
+        static constexpr UniformName INSTANCED = "instanced";
+
+        glState().setColorMask(false);
+        glState().setDepthFunc(GL_LESS);
+        glState().setDepthMask(true);
+        depthPrepass->use();
+        if (depthPrepass != depthPrepassSetUp)
+        {
+            depthPrepass->setBool(INSTANCED, true);
+            depthPrepassSetUp = depthPrepass;
+        }
+        if (gpuProfiler)
+            gpuProfiler->begin(prepassScope);
+        for (size_t b = 0; b < batches.size() && items[order[batches[b].first]].pass == PASS_OPAQUE; b++)
+            drawBatch(batches[b]);
+        if (gpuProfiler)
+            gpuProfiler->end();
+        glState().setColorMask(true);
+    }
+
+    // the geometry of one batch with whatever program is in use; false when nothing was drawn
+    bool drawBatch(const Batch& batch)
+    {
+        const DrawItem& head = items[order[batch.first]];
+        const Mesh& mesh = meshes[head.mesh];
+        glState().bindVertexArray(mesh.VAO);
+        if (mesh.baked)
+        {
+            // the geometry is static, so repeated submissions draw it once
+            return drawParts(mesh);
+        }
+        if (meshFirstInstance[head.mesh] != batch.first)
+        {
+            instances.setFirstInstance(mesh.VAO, (unsigned int)batch.first);
+            meshFirstInstance[head.mesh] = (unsigned int)batch.first;
+        }
+
+        GLsizei count = (GLsizei)(batch.last - batch.first);
+        if (mesh.indexed)
+            glState().drawElementsInstanced(mesh.mode, mesh.count, GL_UNSIGNED_INT, 0, count);
+        else
+            glState().drawArraysInstanced(mesh.mode, 0, mesh.count, count);
+        return true;
+    }
+
+    void cullParts()
+    {
+        if (parts.empty())
+            return;
+        visibleParts.clear();
+        partBounds.cull(frustum, visibleParts);
+        visiblePartCount = (unsigned int)visibleParts.size();
+        partVisible.assign(parts.size(), false);
+        for (size_t i = 0; i < visibleParts.size(); i++)
+            partVisible[visibleParts[i]] = true;
+    }
+
+    // draw the occluders in view into the culler's depth buffer, then drop the items and parts
+    // it finds behind them. Occluders are tested too, one building can hide another
+    void cullOccluded()
+    {
+        occluderBounds.clear();
+        for (size_t i = 0; i < visibleParts.size(); i++)
+        {
+            if (parts[visibleParts[i]].occluder)
+                occluderBounds.push_back(partBounds.get(visibleParts[i]));
+        }
+        occlusionCuller->render(view, projection, occluderBounds);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (occlusionCuller->test(itemBounds.get(order[i])))
+                order[kept++] = order[i];
+        }
+        occludedItemCount = (unsigned int)(order.size() - kept);
+        order.resize(kept);
+
+        for (size_t i = 0; i < visibleParts.size(); i++)
+        {
+            if (!occlusionCuller->test(partBounds.get(visibleParts[i])))
+            {
+                partVisible[visibleParts[i]] = false;
+                occludedPartCount++;
+            }
+        }
+        visiblePartCount -= occludedPartCount;
+    }
+
+    // the visible parts of a baked mesh in one call, nearest first so the far ones fail the
+    // depth test; parts next to each other in the index buffer and in that order merge into one range
+    bool drawParts(const Mesh& mesh)
+    {
+        partOrder.clear();
+        for (unsigned int p = mesh.firstPart; p < mesh.firstPart + mesh.partCount; p++)
+        {
+            if (!partVisible[p])
+                continue;
+            Bounds bounds = partBounds.get(p);
+            glm::vec4 center = view * glm::vec4((bounds.lower + bounds.upper) * 0.5f, 1.0f);
+            partOrder.push_back(std::make_pair(-center.z, p));
+        }
+        std::sort(partOrder.begin(), partOrder.end());
+
+        rangeCounts.clear();
+        rangeOffsets.clear();
+        for (size_t i = 0; i < partOrder.size(); i++)
+        {
+            const MeshPart& part = parts[partOrder[i].second];
+            size_t offset = part.firstIndex * sizeof(unsigned int);
+            if (!rangeCounts.empty() && (size_t)rangeOffsets.back() + rangeCounts.back() * sizeof(unsigned int) == offset)
+            {
+                rangeCounts.back() += part.indexCount;
+                continue;
+            }
+            rangeCounts.push_back((GLsizei)part.indexCount);
+            rangeOffsets.push_back((const void*)offset);
+        }
+        if (rangeCounts.empty())
+            return false;
+        glState().multiDrawElements(mesh.mode, rangeCounts.data(), GL_UNSIGNED_INT, rangeOffsets.data(), (GLsizei)rangeCounts.size());
+        return true;
+    }
+
+    // LSD radix sort of the visible item indices by key, 8 bits per pass; bytes that are the same
+    // for every item (most of the key in a small scene) are skipped
+    void sortItems()
+    {
+        size_t n = order.size();
+        scratch.resize(n);
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            unsigned int histogram[256] = { 0 };
+            for (size_t i = 0; i < n; i++)
+                histogram[(items[order[i]].key >> shift) & 0xFF]++;
+            if (histogram[(items[order[0]].key >> shift) & 0xFF] == n)
+                continue;
+
+            unsigned int offset = 0;
+            for (int b = 0; b < 256; b++)
+            {
+                unsigned int c = histogram[b];
+                histogram[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                unsigned int index = order[i];
+                scratch[histogram[(items[index].key >> shift) & 0xFF]++] = index;
+            }
+            order.swap(scratch);
+        }
+    }
+};
+
+#endif /* renderQueue_h */
@@ -3,12 +3,47 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include "cpuTrace.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "programCache.h"
+#include "shaderSource.h"
 
+#include <memory>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <utility>
+#include <vector>
 #include <iostream>
 
+// 32-bit FNV-1a hash, constexpr so uniform names can be hashed at compile time
+constexpr unsigned int fnv1a(const char* str, unsigned int hash = 2166136261u)
+{
+    return *str ? fnv1a(str + 1, (hash ^ (unsigned char)*str) * 16777619u) : hash;
+}
+
+// a prehashed uniform name; declare it constexpr to keep all string work out of the render loop
+struct UniformName
+{
+    unsigned int hash;
+
+    constexpr UniformName(const char* name) : hash(fnv1a(name)) {}
+    UniformName(const std::string& name) : hash(fnv1a(name.c_str())) {}
+};
+
+// programs compiled this run (not loaded from the program cache), and how many of them the
+// driver had finished before they were first used
+struct ShaderBuildStats
+{
+    unsigned int compiled = 0;
+    unsigned int readyAtFirstUse = 0;
+};
+
+inline ShaderBuildStats& shaderBuildStats()
+{
+    static ShaderBuildStats stats;
+    return stats;
+}
+
 class Shader
 {
 public:
@@ -17,154 +52,281 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
-            if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (geometryPath != nullptr)
-        {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        build(vertexPath, fragmentPath, geometryPath, ShaderDefines());
     }
+    // one variant of the sources, compiled with the given #defines, see shaderSource.h
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines)
+    {
+        build(vertexPath, fragmentPath, nullptr, defines);
+    }
+    // the program owns GL objects, so it is neither copied nor moved
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(ID);
+        if (pending)
+            finish();
+        glState().useProgram(ID);
+    }
+    // true once the driver is done with the program, so using it won't stall; without
+    // KHR_parallel_shader_compile this can only be known by waiting, so it is false until used
+    // ------------------------------------------------------------------------
+    bool isReady() const
+    {
+        if (!pending)
+            return true;
+        if (!glExt().maxShaderCompilerThreads)
+            return false;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+    // location of an active uniform, or -1 (ignored by glUniform*) if the program does not use it;
+    // only known once the program was used
+    // ------------------------------------------------------------------------
+    int getLocation(UniformName name) const
+    {
+        if (uniformLocations.empty())
+            return -1;
+        unsigned int i = name.hash & uniformMask;
+        while (uniformLocations[i] != -1)
+        {
+            if (uniformHashes[i] == name.hash)
+                return uniformLocations[i];
+            i = (i + 1) & uniformMask;
+        }
+        return -1;
+    }
+    // attach a uniform block to a buffer binding point; does nothing if the program has no such block
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char* blockName, unsigned int binding)
+    {
+        // asking for the block would wait for the link, so a pending program binds it in finish()
+        if (pending)
+        {
+            pending->uniformBlocks.push_back(std::make_pair(std::string(blockName), binding));
+            return;
+        }
+        unsigned int index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    void setBool(UniformName name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    void setInt(UniformName name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    void setFloat(UniformName name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setVec2(UniformName name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(getLocation(name), 1, &value[0]);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    void setVec2(UniformName name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setVec3(UniformName name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getLocation(name), 1, &value[0]);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setVec4(UniformName name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(getLocation(name), 1, &value[0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w)
+    void setVec4(UniformName name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    void setMat2(UniformName name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    void setMat3(UniformName name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+    void setMat4(UniformName name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    // shader objects of a program that was submitted but not checked yet
+    struct Pending
+    {
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+        unsigned int geometry = 0;
+        std::string cacheName;
+        unsigned long long sourceHash = 0;
+        std::vector<std::pair<std::string, unsigned int> > uniformBlocks;
+    };
+    std::unique_ptr<Pending> pending;
+
+    // 1. retrieve the vertex/fragment source code from filePath, 2. compile and link it. Nothing
+    // here waits for the driver; the results are checked by finish() when the program is first used
+    // ------------------------------------------------------------------------
+    void build(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& defines)
+    {
+        TRACE_SCOPE("submit shader");
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::string geometryCode;
+        // #include lines are resolved and the defines added while reading
+        ShaderSource::load(vertexPath, defines, vertexCode);
+        ShaderSource::load(fragmentPath, defines, fragmentCode);
+        // if geometry shader path is present, also load a geometry shader
+        if (geometryPath != nullptr)
+            ShaderSource::load(geometryPath, defines, geometryCode);
+        // a program linked on an earlier run from the same sources skips compiling altogether
+        std::string cacheName = std::string(vertexPath) + "|" + fragmentPath + "|" + (geometryPath ? geometryPath : "") + "|" + defines.key();
+        unsigned long long sourceHash = programCache().hash({ vertexCode, fragmentCode, geometryCode });
+        ID = programCache().load(cacheName, sourceHash);
+        if (ID != 0)
+        {
+            cacheUniformLocations();
+            return;
+        }
+        shaderBuildStats().compiled++;
+        pending.reset(new Pending());
+        pending->cacheName = cacheName;
+        pending->sourceHash = sourceHash;
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+        // 2. compile shaders
+        // vertex shader
+        pending->vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(pending->vertex, 1, &vShaderCode, NULL);
+        glCompileShader(pending->vertex);
+        // fragment Shader
+        pending->fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(pending->fragment, 1, &fShaderCode, NULL);
+        glCompileShader(pending->fragment);
+        // if geometry shader is given, compile geometry shader
+        if (geometryPath != nullptr)
+        {
+            const char* gShaderCode = geometryCode.c_str();
+            pending->geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(pending->geometry, 1, &gShaderCode, NULL);
+            glCompileShader(pending->geometry);
+        }
+        // shader Program; linking right away lets the driver work on compile and link together
+        ID = glCreateProgram();
+        glAttachShader(ID, pending->vertex);
+        glAttachShader(ID, pending->fragment);
+        if (pending->geometry)
+            glAttachShader(ID, pending->geometry);
+        programCache().prepare(ID);
+        glLinkProgram(ID);
+    }
+
+    // wait for the submitted program, report errors, store it in the program cache and resolve
+    // its uniforms
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        TRACE_SCOPE("finish shader");
+        if (isReady())
+            shaderBuildStats().readyAtFirstUse++;
+        checkCompileErrors(pending->vertex, "VERTEX");
+        checkCompileErrors(pending->fragment, "FRAGMENT");
+        if (pending->geometry)
+            checkCompileErrors(pending->geometry, "GEOMETRY");
+        if (checkCompileErrors(ID, "PROGRAM"))
+            programCache().store(pending->cacheName, pending->sourceHash, ID);
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(pending->vertex);
+        glDeleteShader(pending->fragment);
+        if (pending->geometry)
+            glDeleteShader(pending->geometry);
+
+        std::unique_ptr<Pending> done = std::move(pending);
+        for (size_t i = 0; i < done->uniformBlocks.size(); i++)
+            bindUniformBlock(done->uniformBlocks[i].first.c_str(), done->uniformBlocks[i].second);
+        cacheUniformLocations();
+    }
+
+    // open addressing table from name hash to uniform location, filled once after linking
+    std::vector<unsigned int> uniformHashes;
+    std::vector<int> uniformLocations;
+    unsigned int uniformMask = 0;
+
+    // resolve every active uniform once so the setters never have to ask the driver
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        // arrays of basic types are reported once as "name[0]", so collect every element name as well
+        std::vector<std::string> names;
+        std::vector<char> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), NULL, &size, &type, buffer.data());
+            std::string name(buffer.data());
+            names.push_back(name);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                names.push_back(base);
+                for (GLint j = 1; j < size; j++)
+                    names.push_back(base + "[" + std::to_string(j) + "]");
+            }
+        }
+
+        unsigned int tableSize = 16;
+        while (tableSize < names.size() * 2)
+            tableSize *= 2;
+        uniformMask = tableSize - 1;
+        uniformHashes.assign(tableSize, 0);
+        uniformLocations.assign(tableSize, -1);
+
+        for (size_t n = 0; n < names.size(); n++)
+        {
+            int location = glGetUniformLocation(ID, names[n].c_str());
+            if (location < 0)
+                continue;   // uniforms inside a uniform block have no location
+            unsigned int hash = fnv1a(names[n].c_str());
+            unsigned int i = hash & uniformMask;
+            while (uniformLocations[i] != -1 && uniformHashes[i] != hash)
+                i = (i + 1) & uniformMask;
+            if (uniformLocations[i] != -1 && uniformLocations[i] != location)
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << names[n] << std::endl;
+            uniformHashes[i] = hash;
+            uniformLocations[i] = location;
+        }
+    }
+
+    // utility function for checking shader compilation/linking errors; false if there were any
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -186,6 +348,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
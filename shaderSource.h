@@ -0,0 +1,157 @@
+//
+//  shaderSource.h
+//  3D-Shooter
+//
+//  Loads GLSL files for the Shader class: resolves #include "file" lines relative to the
+//  including file and puts a set of #defines right after the #version line, so one source file
+//  can be compiled into several variants.
+//
+
+#ifndef shaderSource_h
+#define shaderSource_h
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// the #defines a variant is compiled with; kept sorted so equal sets give equal keys
+class ShaderDefines
+{
+public:
+    ShaderDefines& set(const std::string& name, int value)
+    {
+        values[name] = value;
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return values.empty();
+    }
+
+    // e.g. "QUALITY=1 TEXTURED=0", used to tell variants apart
+    std::string key() const
+    {
+        std::string key;
+        for (std::map<std::string, int>::const_iterator it = values.begin(); it != values.end(); ++it)
+        {
+            if (!key.empty())
+                key += ' ';
+            key += it->first + "=" + std::to_string(it->second);
+        }
+        return key;
+    }
+
+    std::string header() const
+    {
+        std::string header;
+        for (std::map<std::string, int>::const_iterator it = values.begin(); it != values.end(); ++it)
+            header += "#define " + it->first + " " + std::to_string(it->second) + "\n";
+        return header;
+    }
+
+private:
+    std::map<std::string, int> values;
+};
+
+class ShaderSource
+{
+public:
+    // the preprocessed code of path with defines, or false if a file could not be read. #line
+    // directives keep compiler messages pointing at the right line; their source string number
+    // is the file's index in files
+    static bool load(const char* path, const ShaderDefines& defines, std::string& code, std::vector<std::string>* files = NULL)
+    {
+        std::vector<std::string> localFiles;
+        std::vector<std::string>& included = files ? *files : localFiles;
+        included.clear();
+
+        std::string body;
+        if (!expand(path, included, 0, body))
+            return false;
+
+        // #version has to stay the first line, so the defines go right behind it
+        size_t version = body.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : body.find('\n', version);
+        if (lineEnd == std::string::npos)
+        {
+            code = defines.header() + "#line 1 0\n" + body;
+            return true;
+        }
+        int versionLine = 1 + (int)std::count(body.begin(), body.begin() + lineEnd, '\n');
+        code = body.substr(0, lineEnd + 1) + defines.header() + "#line " + std::to_string(versionLine + 1) + " 0\n" + body.substr(lineEnd + 1);
+        return true;
+    }
+
+private:
+    // nested includes deeper than this are taken to be a cycle
+    static const int MAX_INCLUDE_DEPTH = 8;
+
+    static bool readFile(const std::string& path, std::string& text)
+    {
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        if (!file)
+            return false;
+        std::stringstream stream;
+        stream << file.rdbuf();
+        text = stream.str();
+        return true;
+    }
+
+    static std::string directoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    static bool expand(const std::string& path, std::vector<std::string>& files, int depth, std::string& out)
+    {
+        std::string text;
+        if (!readFile(path, text))
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        if (depth > MAX_INCLUDE_DEPTH)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP: " << path << std::endl;
+            return false;
+        }
+        int fileIndex = (int)files.size();
+        files.push_back(path);
+
+        std::istringstream lines(text);
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', start + 8);
+                size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+                if (close == std::string::npos)
+                {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << lineNumber << std::endl;
+                    return false;
+                }
+                std::string included = directoryOf(path) + line.substr(open + 1, close - open - 1);
+                out += "#line 1 " + std::to_string(files.size()) + "\n";
+                if (!expand(included, files, depth + 1, out))
+                    return false;
+                out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+                continue;
+            }
+            out += line;
+            out += '\n';
+        }
+        return true;
+    }
+};
+
+#endif /* shaderSource_h */
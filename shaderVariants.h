@@ -0,0 +1,91 @@
+//
+//  shaderVariants.h
+//  3D-Shooter
+//
+//  Cache of the variants of one vertex/fragment pair, keyed by their #defines. A variant is
+//  compiled the first time it is asked for, or earlier if prepared, so only the combinations a
+//  run really draws with are ever built.
+//
+
+#ifndef shaderVariants_h
+#define shaderVariants_h
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "shader.h"
+#include "shaderSource.h"
+
+class ShaderVariants
+{
+public:
+    // prepares a freshly compiled variant (uniform blocks, sampler units, ...) and returns the
+    // id callers know it by, e.g. its render queue program
+    typedef std::function<unsigned int(Shader&)> Setup;
+
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, Setup setup)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), setup(setup)
+    {
+    }
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // start compiling a variant that will likely be needed, so the driver can work on it before
+    // the first get() asks for it
+    void prepare(const ShaderDefines& defines)
+    {
+        submit(defines);
+    }
+
+    // the id setup returned for this set of defines, compiling the variant on first use
+    unsigned int get(const ShaderDefines& defines)
+    {
+        Variant& variant = submit(defines);
+        if (!variant.setUp)
+        {
+            variant.id = setup(*variant.shader);
+            variant.setUp = true;
+        }
+        return variant.id;
+    }
+
+    size_t size() const
+    {
+        return variants.size();
+    }
+
+    // "key; key; ..." of every variant compiled so far
+    std::string describe() const
+    {
+        std::string keys;
+        for (std::map<std::string, Variant>::const_iterator it = variants.begin(); it != variants.end(); ++it)
+            keys += (keys.empty() ? "" : "; ") + it->first;
+        return keys;
+    }
+
+private:
+    struct Variant
+    {
+        std::unique_ptr<Shader> shader;
+        unsigned int id = 0;
+        bool setUp = false;
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    Setup setup;
+    std::map<std::string, Variant> variants;
+
+    Variant& submit(const ShaderDefines& defines)
+    {
+        Variant& variant = variants[defines.key()];
+        if (!variant.shader)
+            variant.shader.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+        return variant;
+    }
+};
+
+#endif /* shaderVariants_h */
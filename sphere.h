@@ -37,7 +37,7 @@ public:
         buildVertices();
 
         glGenVertexArrays(1, &sphereVAO);
-        glBindVertexArray(sphereVAO);
+        glState().bindVertexArray(sphereVAO);
 
         // create VBO to copy vertex data to VBO
         unsigned int sphereVBO;
@@ -67,7 +67,7 @@ public:
         glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (void*)(sizeof(float) * 3));
 
         // unbind VAO and VBOs
-        glBindVertexArray(0);
+        glState().bindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
@@ -151,27 +151,34 @@ public:
         return (unsigned int)indices.size();
     }
 
-    // draw in VertexArray mode
+    // draw in VertexArray mode; with a render queue program, call RenderQueue::invalidateProgram()
+    // after, this leaves its uniforms set for one plain draw
     void drawSphere(Shader& lightingShader, glm::mat4 model) const      // draw surface
     {
+        static constexpr UniformName MATERIAL_AMBIENT = "material.ambient";
+        static constexpr UniformName MATERIAL_DIFFUSE = "material.diffuse";
+        static constexpr UniformName MATERIAL_SPECULAR = "material.specular";
+        static constexpr UniformName MATERIAL_SHININESS = "material.shininess";
+        static constexpr UniformName MODEL = "model";
+        static constexpr UniformName INSTANCED = "instanced";
+
         lightingShader.use();
+        // render queue programs are left drawing instances
+        lightingShader.setBool(INSTANCED, false);
 
-        lightingShader.setVec3("material.ambient", this->ambient);
-        lightingShader.setVec3("material.diffuse", this->diffuse);
-        lightingShader.setVec3("material.specular", this->specular);
-        lightingShader.setFloat("material.shininess", this->shininess);
+        lightingShader.setVec3(MATERIAL_AMBIENT, this->ambient);
+        lightingShader.setVec3(MATERIAL_DIFFUSE, this->diffuse);
+        lightingShader.setVec3(MATERIAL_SPECULAR, this->specular);
+        lightingShader.setFloat(MATERIAL_SHININESS, this->shininess);
 
-        lightingShader.setMat4("model", model);
+        lightingShader.setMat4(MODEL, model);
 
-        // draw a sphere with VAO
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES,                    // primitive type
+        // draw a sphere with VAO; it stays bound, the state cache knows about it
+        glState().bindVertexArray(sphereVAO);
+        glState().drawElements(GL_TRIANGLES,                   // primitive type
             this->getIndexCount(),          // # of indices
             GL_UNSIGNED_INT,                 // data type
             (void*)0);                       // offset to indices
-
-        // unbind VAO
-        glBindVertexArray(0);
     }
 
 private:
@@ -0,0 +1,158 @@
+//
+//  staticBatch.h
+//  3D-Shooter
+//
+//  Bakes meshes that never move into one vertex/index buffer at load time. Positions and normals
+//  are pre-transformed to world space and the tint and texture array layer are stored per vertex,
+//  so the whole static scene is one draw with no per-frame matrix math. Each added mesh stays a
+//  separate index range with its own box, so invisible ones can be left out of that draw.
+//
+
+#ifndef staticBatch_h
+#define staticBatch_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "cpuTrace.h"
+#include "glState.h"
+#include "instanceBuffer.h"
+#include "frustum.h"
+
+// baked vertex: position, normal, uv, color, layer
+const unsigned int STATIC_VERTEX_FLOATS = 12;
+
+class StaticBatch
+{
+public:
+    // one added mesh: its range of the index buffer and its world space box
+    struct Part
+    {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        Bounds bounds;
+    };
+
+    unsigned int VAO;
+    unsigned int indexCount;
+    glm::vec3 center;               // world space center, used for depth sorting
+    std::vector<Part> parts;        // in index buffer order
+
+    StaticBatch() : VAO(0), indexCount(0), center(0.0f), VBO(0), EBO(0), instanceVBO(0)
+    {
+    }
+
+    // queue a mesh for baking. vertices hold position and normal, followed by a uv pair when
+    // hasTexCoords is set; pass no indices for meshes drawn with glDrawArrays. layer is the mesh's
+    // texture array layer, negative for untextured
+    void add(const float* vertices, unsigned int vertexCount, bool hasTexCoords, const unsigned int* indices, unsigned int indexCount,
+        const glm::mat4& model, const glm::vec3& color, int layer)
+    {
+        unsigned int stride = hasTexCoords ? 8 : 6;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        unsigned int firstVertex = (unsigned int)(pendingVertices.size() / STATIC_VERTEX_FLOATS);
+        Part part = { (unsigned int)pendingIndices.size(), 0, { glm::vec3(1e30f), glm::vec3(-1e30f) } };
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            const float* src = vertices + v * stride;
+            glm::vec3 position = glm::vec3(model * glm::vec4(src[0], src[1], src[2], 1.0f));
+            glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(src[3], src[4], src[5]));
+            part.bounds.lower = glm::min(part.bounds.lower, position);
+            part.bounds.upper = glm::max(part.bounds.upper, position);
+            float u = hasTexCoords ? src[6] : 0.0f;
+            float w = hasTexCoords ? src[7] : 0.0f;
+
+            float baked[STATIC_VERTEX_FLOATS] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, u, w, color.r, color.g, color.b, (float)layer };
+            pendingVertices.insert(pendingVertices.end(), baked, baked + STATIC_VERTEX_FLOATS);
+        }
+
+        if (indices != NULL)
+        {
+            for (unsigned int i = 0; i < indexCount; i++)
+                pendingIndices.push_back(firstVertex + indices[i]);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < vertexCount; i++)
+                pendingIndices.push_back(firstVertex + i);
+        }
+        part.indexCount = (unsigned int)pendingIndices.size() - part.firstIndex;
+        parts.push_back(part);
+    }
+
+    // upload the queued meshes; the CPU copies are released afterwards
+    void build()
+    {
+        TRACE_SCOPE("bake static batch");
+        // center from the baked positions
+        glm::vec3 lo(1e30f), hi(-1e30f);
+        for (size_t v = 0; v < pendingVertices.size(); v += STATIC_VERTEX_FLOATS)
+        {
+            glm::vec3 position(pendingVertices[v], pendingVertices[v + 1], pendingVertices[v + 2]);
+            lo = glm::min(lo, position);
+            hi = glm::max(hi, position);
+        }
+        center = (lo + hi) * 0.5f;
+        indexCount = (unsigned int)pendingIndices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &instanceVBO);
+
+        glState().bindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, pendingVertices.size() * sizeof(float), pendingVertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, pendingIndices.size() * sizeof(unsigned int), pendingIndices.data(), GL_STATIC_DRAW);
+
+        GLsizei stride = STATIC_VERTEX_FLOATS * sizeof(float);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+
+        // tint and layer go into the instance slots, but advance per vertex
+        glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
+        glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+        glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, stride, (void*)(11 * sizeof(float)));
+        glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+
+        // the instanced shader path still wants a model matrix; the geometry is already in world space
+        glm::mat4 identity(1.0f);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), &identity, GL_STATIC_DRAW);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * i));
+            glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+        }
+
+        glState().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        vertexCount = (unsigned int)(pendingVertices.size() / STATIC_VERTEX_FLOATS);
+        std::vector<float>().swap(pendingVertices);
+        std::vector<unsigned int>().swap(pendingIndices);
+    }
+
+    unsigned int getVertexCount() const
+    {
+        return vertexCount;
+    }
+
+private:
+    unsigned int VBO, EBO, instanceVBO;
+    unsigned int vertexCount = 0;
+    std::vector<float> pendingVertices;
+    std::vector<unsigned int> pendingIndices;
+};
+
+#endif /* staticBatch_h */
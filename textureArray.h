@@ -0,0 +1,129 @@
+//
+//  textureArray.h
+//  3D-Shooter
+//
+//  2D array texture whose layers all share one size and format, so every textured mesh can
+//  sample it through one binding and pick its image by layer index. Storage is immutable when
+//  the driver has glTexStorage3D, allocated level by level otherwise. Filtering and wrapping come
+//  from a shared sampler object, not from the texture itself.
+//
+
+#ifndef textureArray_h
+#define textureArray_h
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "glState.h"
+#include "glExtensions.h"
+
+class TextureArray
+{
+public:
+    GLuint ID;
+    int width;
+    int height;
+    int levels;
+    int layers;
+    GLenum internalFormat;
+    bool compressed;
+    int assigned;           // layers handed out so far
+    int complete;           // layers whose levels are all uploaded
+
+    TextureArray() : ID(0), width(0), height(0), levels(0), layers(0), internalFormat(0), compressed(false), assigned(0), complete(0)
+    {
+    }
+
+    // number of levels in a full chain down to 1x1
+    static int fullMipCount(int width, int height)
+    {
+        int count = 1;
+        while (width > 1 || height > 1)
+        {
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            count++;
+        }
+        return count;
+    }
+
+    // bytes per 4x4 block of a compressed format
+    static int blockBytesFor(GLenum internalFormat)
+    {
+        return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? 8 : 16;
+    }
+
+    // trilinear, repeating sampler used for every scene texture
+    static GLuint sharedSampler()
+    {
+        static GLuint sampler = 0;
+        if (sampler == 0)
+        {
+            glGenSamplers(1, &sampler);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        return sampler;
+    }
+
+    // allocate every level of every layer; internalFormat is GL_RGBA8, GL_SRGB8_ALPHA8 or a
+    // block-compressed format
+    void create(int width, int height, int levels, int layers, GLenum internalFormat)
+    {
+        this->width = width;
+        this->height = height;
+        this->levels = levels;
+        this->layers = layers;
+        this->internalFormat = internalFormat;
+        compressed = internalFormat != GL_RGBA8 && internalFormat != GL_SRGB8_ALPHA8;
+
+        glGenTextures(1, &ID);
+        glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, ID);
+        if (glExt().texStorage3D)
+        {
+            glExt().texStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+        }
+        else
+        {
+            for (int level = 0; level < levels; level++)
+            {
+                int w = std::max(1, width >> level), h = std::max(1, height >> level);
+                if (compressed)
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, layers, 0,
+                        ((w + 3) / 4) * ((h + 3) / 4) * blockBytesFor(internalFormat) * layers, NULL);
+                else
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+
+    // fill one level of one layer with RGBA8 texels or compressed blocks
+    void upload(int level, int layer, const void* data, size_t size)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, ID);
+        if (compressed)
+        {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, internalFormat, (GLsizei)size, data);
+        }
+        else
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+    }
+
+    // the base level applies to all layers at once
+    void setBaseLevel(int level)
+    {
+        glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, ID);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+    }
+};
+
+#endif /* textureArray_h */
@@ -0,0 +1,201 @@
+//
+//  textureCache.h
+//  3D-Shooter
+//
+//  On-disk cache of decoded, mip-mapped texel data. Each source image gets one file that records
+//  a hash of the image's bytes; a changed image no longer matches and is decoded and cached again.
+//  Cache files are memory-mapped and uploaded straight from the mapping.
+//
+
+#ifndef textureCache_h
+#define textureCache_h
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "mappedFile.h"
+
+// bump when the layout or the mip filter changes, so old cache files are rebuilt
+const unsigned int TEXTURE_CACHE_VERSION = 1;
+
+enum TexelFormat {
+    TEXEL_RGBA8 = 0,
+    TEXEL_RG8 = 1,
+    TEXEL_R8 = 2,
+    TEXEL_BC1 = 3,
+    TEXEL_BC7 = 4
+};
+
+struct TextureCacheHeader
+{
+    char magic[4];                  // "TXC1"
+    unsigned int version;
+    unsigned long long sourceHash;  // FNV-1a of the source file's bytes
+    unsigned int format;            // TexelFormat
+    unsigned int channels;          // channel count of the source image
+    unsigned int levelCount;
+    unsigned int pad;
+};
+
+struct TextureCacheLevel
+{
+    unsigned int width;
+    unsigned int height;
+    unsigned long long offset;      // from the start of the file
+    unsigned long long size;
+};
+
+// a texture's levels laid out back to back, in memory or in a mapped cache file
+struct TextureLevel
+{
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+// 64-bit FNV-1a, good enough to notice that an image file changed
+inline unsigned long long hashBytes(const unsigned char* bytes, size_t size)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class TextureCache
+{
+public:
+    // an empty directory disables the cache
+    explicit TextureCache(const std::string& directory) : directory(directory)
+    {
+        if (directory.empty())
+            return;
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+
+    bool isEnabled() const
+    {
+        return !directory.empty();
+    }
+
+    // map the cache file of an image; fails when there is none or it belongs to other image bytes
+    bool read(const std::string& sourcePath, unsigned long long sourceHash, MappedFile& file, std::vector<TextureLevel>& levels,
+        unsigned int& format, int& channels) const
+    {
+        if (!isEnabled() || !file.open(cachePath(sourcePath).c_str()))
+            return false;
+
+        TextureCacheHeader header;
+        if (file.size() < sizeof(header))
+            return reject(file);
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "TXC1", 4) != 0 || header.version != TEXTURE_CACHE_VERSION || header.sourceHash != sourceHash
+            || header.levelCount == 0 || file.size() < sizeof(header) + header.levelCount * sizeof(TextureCacheLevel))
+            return reject(file);
+
+        levels.clear();
+        for (unsigned int i = 0; i < header.levelCount; i++)
+        {
+            TextureCacheLevel entry;
+            std::memcpy(&entry, file.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+            if (entry.offset + entry.size > file.size())
+                return reject(file);
+            TextureLevel level = { (int)entry.width, (int)entry.height, (size_t)entry.offset, (size_t)entry.size };
+            levels.push_back(level);
+        }
+        format = header.format;
+        channels = (int)header.channels;
+        return true;
+    }
+
+    // store the levels of an image; written to a temporary file first so a crash never leaves a torn entry
+    bool write(const std::string& sourcePath, unsigned long long sourceHash, const unsigned char* texels, const std::vector<TextureLevel>& levels,
+        unsigned int format, int channels) const
+    {
+        if (!isEnabled())
+            return false;
+
+        std::string path = cachePath(sourcePath);
+        std::string temporary = path + ".tmp";
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+            return false;
+
+        TextureCacheHeader header;
+        std::memcpy(header.magic, "TXC1", 4);
+        header.version = TEXTURE_CACHE_VERSION;
+        header.sourceHash = sourceHash;
+        header.format = format;
+        header.channels = (unsigned int)channels;
+        header.levelCount = (unsigned int)levels.size();
+        header.pad = 0;
+
+        // texel data starts 16-byte aligned after the level table
+        size_t dataStart = (sizeof(header) + levels.size() * sizeof(TextureCacheLevel) + 15) & ~(size_t)15;
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        for (size_t i = 0; i < levels.size() && ok; i++)
+        {
+            TextureCacheLevel entry = { (unsigned int)levels[i].width, (unsigned int)levels[i].height,
+                dataStart + (levels[i].offset - levels[0].offset), levels[i].size };
+            ok = std::fwrite(&entry, sizeof(entry), 1, file) == 1;
+        }
+        const unsigned char padding[16] = { 0 };
+        size_t written = sizeof(header) + levels.size() * sizeof(TextureCacheLevel);
+        if (ok && dataStart > written)
+            ok = std::fwrite(padding, 1, dataStart - written, file) == dataStart - written;
+
+        // the levels are contiguous, so the data goes out in one write
+        const TextureLevel& last = levels.back();
+        size_t dataSize = last.offset + last.size - levels[0].offset;
+        if (ok)
+            ok = std::fwrite(texels + levels[0].offset, 1, dataSize, file) == dataSize;
+        ok = std::fclose(file) == 0 && ok;
+
+        if (ok)
+        {
+            std::remove(path.c_str());
+            ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+        if (!ok)
+            std::remove(temporary.c_str());
+        return ok;
+    }
+
+private:
+    std::string directory;
+
+    std::string cachePath(const std::string& sourcePath) const
+    {
+        std::string name = sourcePath;
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            if (name[i] == '/' || name[i] == '\\' || name[i] == ':')
+                name[i] = '_';
+        }
+        return directory + "/" + name + ".texcache";
+    }
+
+    static bool reject(MappedFile& file)
+    {
+        file.close();
+        return false;
+    }
+};
+
+#endif /* textureCache_h */
@@ -0,0 +1,408 @@
+//
+//  textureCompressor.h
+//  3D-Shooter
+//
+//  CPU encoder from RGBA8 mip levels to BC1 (4 bits per texel, no alpha) and BC7 mode 6
+//  (8 bits per texel, RGBA). Endpoints come from the block's bounding box along its main
+//  diagonal, so encoding is fast enough to run at load time; large levels are split across
+//  threads by block rows.
+//
+
+#ifndef textureCompressor_h
+#define textureCompressor_h
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "textureCache.h"
+
+enum TextureCompression {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_BC1,
+    COMPRESSION_BC7
+};
+
+// bytes per 4x4 block
+inline int compressedBlockBytes(TextureCompression compression)
+{
+    return compression == COMPRESSION_BC1 ? 8 : 16;
+}
+
+inline size_t compressedLevelSize(int width, int height, TextureCompression compression)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(compression);
+}
+
+// copy the 4x4 block at block coordinates (bx, by) out of an RGBA8 image, repeating the last
+// row and column where the image ends inside the block
+inline void fetchBlock(const unsigned char* texels, int width, int height, int bx, int by, unsigned char block[64])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        const unsigned char* row = texels + (size_t)std::min(by * 4 + y, height - 1) * width * 4;
+        if (bx * 4 + 4 <= width)
+        {
+            std::memcpy(block + y * 16, row + bx * 16, 16);
+            continue;
+        }
+        for (int x = 0; x < 4; x++)
+            std::memcpy(block + y * 16 + x * 4, row + std::min(bx * 4 + x, width - 1) * 4, 4);
+    }
+}
+
+// per-channel minimum and maximum of a block
+inline void blockBounds(const unsigned char block[64], unsigned char low[4], unsigned char high[4])
+{
+#ifdef TEXTURE_COMPRESSOR_SSE2
+    __m128i row0 = _mm_loadu_si128((const __m128i*)block);
+    __m128i row1 = _mm_loadu_si128((const __m128i*)(block + 16));
+    __m128i row2 = _mm_loadu_si128((const __m128i*)(block + 32));
+    __m128i row3 = _mm_loadu_si128((const __m128i*)(block + 48));
+    __m128i minimum = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+    __m128i maximum = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+
+    // fold the four pixels of each row into one
+    minimum = _mm_min_epu8(minimum, _mm_shuffle_epi32(minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+    minimum = _mm_min_epu8(minimum, _mm_shuffle_epi32(minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+    maximum = _mm_max_epu8(maximum, _mm_shuffle_epi32(maximum, _MM_SHUFFLE(1, 0, 3, 2)));
+    maximum = _mm_max_epu8(maximum, _mm_shuffle_epi32(maximum, _MM_SHUFFLE(2, 3, 0, 1)));
+    int lowBits = _mm_cvtsi128_si32(minimum);
+    int highBits = _mm_cvtsi128_si32(maximum);
+    std::memcpy(low, &lowBits, 4);
+    std::memcpy(high, &highBits, 4);
+#else
+    for (int c = 0; c < 4; c++)
+    {
+        low[c] = 255;
+        high[c] = 0;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            low[c] = std::min(low[c], block[i * 4 + c]);
+            high[c] = std::max(high[c], block[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+// endpoints spanning the block: the bounding box, flipped per channel so it follows the
+// block's colors along the right diagonal, then pulled in by 1/16 of the range on both ends
+inline void blockEndpoints(const unsigned char block[64], int channels, int start[4], int end[4])
+{
+    unsigned char low[4], high[4];
+    blockBounds(block, low, high);
+
+    int widest = 0;
+    for (int c = 1; c < channels; c++)
+    {
+        if (high[c] - low[c] > high[widest] - low[widest])
+            widest = c;
+    }
+
+    int mean[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < channels; c++)
+            mean[c] += block[i * 4 + c];
+    }
+    int covariance[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        int reference = block[i * 4 + widest] * 16 - mean[widest];
+        for (int c = 0; c < channels; c++)
+            covariance[c] += (block[i * 4 + c] * 16 - mean[c]) * reference;
+    }
+
+    for (int c = 0; c < 4; c++)
+    {
+        start[c] = low[c];
+        end[c] = high[c];
+        if (c < channels && covariance[c] < 0)
+            std::swap(start[c], end[c]);
+        int inset = (end[c] - start[c]) / 16;
+        start[c] += inset;
+        end[c] -= inset;
+    }
+}
+
+// index of the nearest palette entry for every pixel of a block, by squared RGB(A) distance
+inline void selectIndices(const unsigned char block[64], const unsigned char palette[][4], int count, bool alpha, unsigned char indices[16])
+{
+#ifdef TEXTURE_COMPRESSOR_SSE2
+    // pixels as 16-bit channels, two per register; alpha is masked out when it doesn't count
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i channelMask = alpha ? _mm_set1_epi16(-1) : _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    __m128i pixels[8];
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i row = _mm_loadu_si128((const __m128i*)(block + i * 16));
+        pixels[i * 2] = _mm_and_si128(_mm_unpacklo_epi8(row, zero), channelMask);
+        pixels[i * 2 + 1] = _mm_and_si128(_mm_unpackhi_epi8(row, zero), channelMask);
+    }
+
+    __m128i best[4], bestIndex[4];
+    for (int i = 0; i < 4; i++)
+    {
+        best[i] = _mm_set1_epi32(0x7fffffff);
+        bestIndex[i] = zero;
+    }
+    for (int k = 0; k < count; k++)
+    {
+        const unsigned char* p = palette[k];
+        __m128i color = _mm_and_si128(_mm_set_epi16(p[3], p[2], p[1], p[0], p[3], p[2], p[1], p[0]), channelMask);
+        __m128i index = _mm_set1_epi32(k);
+        for (int i = 0; i < 4; i++)
+        {
+            // madd gives r*r+g*g and b*b+a*a per pixel; add the pairs for four pixels at once
+            __m128i d0 = _mm_sub_epi16(pixels[i * 2], color);
+            __m128i d1 = _mm_sub_epi16(pixels[i * 2 + 1], color);
+            __m128 s0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0));
+            __m128 s1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+            __m128i distance = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+            __m128i closer = _mm_cmplt_epi32(distance, best[i]);
+            best[i] = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best[i]));
+            bestIndex[i] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex[i]));
+        }
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        int lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, bestIndex[i]);
+        for (int j = 0; j < 4; j++)
+            indices[i * 4 + j] = (unsigned char)lanes[j];
+    }
+#else
+    int channels = alpha ? 4 : 3;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0x7fffffff;
+        for (int k = 0; k < count; k++)
+        {
+            int distance = 0;
+            for (int c = 0; c < channels; c++)
+            {
+                int d = block[i * 4 + c] - palette[k][c];
+                distance += d * d;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = (unsigned char)k;
+            }
+        }
+    }
+#endif
+}
+
+inline unsigned short packColor565(const int color[4])
+{
+    int r = (std::min(255, std::max(0, color[0])) * 31 + 127) / 255;
+    int g = (std::min(255, std::max(0, color[1])) * 63 + 127) / 255;
+    int b = (std::min(255, std::max(0, color[2])) * 31 + 127) / 255;
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackColor565(unsigned short packed, unsigned char color[4])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (unsigned char)((r << 3) | (r >> 2));
+    color[1] = (unsigned char)((g << 2) | (g >> 4));
+    color[2] = (unsigned char)((b << 3) | (b >> 2));
+    color[3] = 255;
+}
+
+// BC1: two RGB565 endpoints and a 2-bit index per pixel into them and two colors between
+inline void encodeBC1Block(const unsigned char block[64], unsigned char out[8])
+{
+    int start[4], end[4];
+    blockEndpoints(block, 3, start, end);
+    unsigned short color0 = packColor565(start);
+    unsigned short color1 = packColor565(end);
+
+    // color0 > color1 selects the four color mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    unsigned int bits = 0;
+    if (color0 != color1)
+    {
+        unsigned char palette[4][4];
+        unpackColor565(color0, palette[0]);
+        unpackColor565(color1, palette[1]);
+        for (int c = 0; c < 4; c++)
+        {
+            palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+            palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+        }
+        unsigned char indices[16];
+        selectIndices(block, palette, 4, false, indices);
+        for (int i = 0; i < 16; i++)
+            bits |= (unsigned int)indices[i] << (i * 2);
+    }
+
+    out[0] = (unsigned char)(color0 & 0xff);
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)(color1 & 0xff);
+    out[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+// appends 'count' bits of 'value' to a little-endian bit stream
+inline void writeBits(unsigned char* out, int& position, unsigned int value, int count)
+{
+    for (int i = 0; i < count; i++, position++)
+    {
+        if (value & (1u << i))
+            out[position / 8] |= (unsigned char)(1 << (position % 8));
+    }
+}
+
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared low bit per endpoint, and a
+// 4-bit index per pixel into 16 colors between them
+inline void encodeBC7Block(const unsigned char block[64], unsigned char out[16])
+{
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    int endpoints[2][4];
+    blockEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+    // pick the low bit that lands each endpoint closest to where it should be
+    int quantized[2][4];
+    int pbits[2];
+    unsigned char ends[2][4];
+    for (int e = 0; e < 2; e++)
+    {
+        int bestError = 0x7fffffff;
+        for (int p = 0; p < 2; p++)
+        {
+            int error = 0;
+            int q[4];
+            for (int c = 0; c < 4; c++)
+            {
+                q[c] = std::min(127, std::max(0, (endpoints[e][c] - p + 1) >> 1));
+                int d = ((q[c] << 1) | p) - endpoints[e][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pbits[e] = p;
+                for (int c = 0; c < 4; c++)
+                {
+                    quantized[e][c] = q[c];
+                    ends[e][c] = (unsigned char)((q[c] << 1) | p);
+                }
+            }
+        }
+    }
+
+    unsigned char palette[16][4];
+    for (int k = 0; k < 16; k++)
+    {
+        for (int c = 0; c < 4; c++)
+            palette[k][c] = (unsigned char)(((64 - weights[k]) * ends[0][c] + weights[k] * ends[1][c] + 32) >> 6);
+    }
+    unsigned char indices[16];
+    selectIndices(block, palette, 16, true, indices);
+
+    // the first pixel's index is stored without its top bit, so it must point at the first half
+    if (indices[0] & 8)
+    {
+        for (int c = 0; c < 4; c++)
+            std::swap(quantized[0][c], quantized[1][c]);
+        std::swap(pbits[0], pbits[1]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = (unsigned char)(15 - indices[i]);
+    }
+
+    std::memset(out, 0, 16);
+    int position = 0;
+    writeBits(out, position, 1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writeBits(out, position, quantized[0][c], 7);
+        writeBits(out, position, quantized[1][c], 7);
+    }
+    writeBits(out, position, pbits[0], 1);
+    writeBits(out, position, pbits[1], 1);
+    writeBits(out, position, indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writeBits(out, position, indices[i], 4);
+}
+
+// encode block rows [firstRow, lastRow) of one RGBA8 level
+inline void compressBlockRows(const unsigned char* texels, int width, int height, TextureCompression compression,
+    unsigned char* out, int firstRow, int lastRow)
+{
+    int blocksWide = (width + 3) / 4;
+    int blockBytes = compressedBlockBytes(compression);
+    unsigned char block[64];
+    for (int by = firstRow; by < lastRow; by++)
+    {
+        for (int bx = 0; bx < blocksWide; bx++)
+        {
+            fetchBlock(texels, width, height, bx, by, block);
+            unsigned char* destination = out + ((size_t)by * blocksWide + bx) * blockBytes;
+            if (compression == COMPRESSION_BC1)
+                encodeBC1Block(block, destination);
+            else
+                encodeBC7Block(block, destination);
+        }
+    }
+}
+
+// encode one RGBA8 level; levels with enough blocks are split across threads
+inline void compressLevel(const unsigned char* texels, int width, int height, TextureCompression compression, unsigned char* out,
+    unsigned int threads)
+{
+    const int BLOCKS_PER_THREAD = 4096;
+    int blockRows = (height + 3) / 4;
+    int blocks = blockRows * ((width + 3) / 4);
+    threads = std::max(1u, std::min(threads, (unsigned int)(blocks / BLOCKS_PER_THREAD)));
+    if (threads == 1)
+    {
+        compressBlockRows(texels, width, height, compression, out, 0, blockRows);
+        return;
+    }
+
+    std::vector<std::thread> helpers;
+    for (unsigned int i = 1; i < threads; i++)
+        helpers.push_back(std::thread(compressBlockRows, texels, width, height, compression, out,
+            (int)(blockRows * i / threads), (int)(blockRows * (i + 1) / threads)));
+    compressBlockRows(texels, width, height, compression, out, 0, (int)(blockRows / threads));
+    for (size_t i = 0; i < helpers.size(); i++)
+        helpers[i].join();
+}
+
+// encode a whole RGBA8 chain; the compressed levels keep their texel sizes and are laid out back
+// to back like the uncompressed ones
+inline void compressMipChain(const unsigned char* texels, const std::vector<TextureLevel>& levels, TextureCompression compression,
+    std::vector<TextureLevel>& compressedLevels, std::vector<unsigned char>& storage, unsigned int threads)
+{
+    compressedLevels.clear();
+    size_t total = 0;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        TextureLevel level = { levels[i].width, levels[i].height, total, compressedLevelSize(levels[i].width, levels[i].height, compression) };
+        compressedLevels.push_back(level);
+        total += level.size;
+    }
+
+    storage.resize(total);
+    for (size_t i = 0; i < levels.size(); i++)
+        compressLevel(texels + levels[i].offset, levels[i].width, levels[i].height, compression, &storage[compressedLevels[i].offset], threads);
+}
+
+#endif /* textureCompressor_h */
@@ -0,0 +1,482 @@
+//
+//  textureLoader.h
+//  3D-Shooter
+//
+//  Decodes images into the layers of a TextureArray, resampled to the array's size, and builds
+//  their mip chains on worker threads. The array gets its storage and a placeholder in its last
+//  level right away, and the real levels are uploaded by pump() on the GL thread as the decodes
+//  finish, so the first frames render while big images still load. Colour textures can be
+//  block-compressed after the chain is built. Decoded and compressed chains are kept in a
+//  TextureCache, so later runs skip both.
+//
+
+#ifndef textureLoader_h
+#define textureLoader_h
+
+#include <glad/glad.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_LOADER_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stb/stb_image.h"
+
+#include "cpuTrace.h"
+#include "glState.h"
+#include "textureArray.h"
+#include "textureCache.h"
+#include "textureCompressor.h"
+
+// the levels of one array layer, with 'components' bytes per texel or compressed
+struct DecodedTexture
+{
+    TextureArray* array;                // the array and layer the levels go into
+    int layer;
+    int width;                          // size the image is resampled to
+    int height;
+    std::string path;
+    int channels;                       // channel count of the source image
+    int components;                     // bytes per decoded texel
+    unsigned int format;                // TexelFormat of the levels
+    std::vector<TextureLevel> levels;   // empty when decoding failed
+    std::vector<unsigned char> storage; // decoded levels, back to back
+    MappedFile mapping;                 // or the cache file they were found in
+
+    const unsigned char* texels() const
+    {
+        return mapping.isOpen() ? mapping.data() : storage.data();
+    }
+};
+
+// 2x2 box filter of an 8-bit image into one of half the size (rounded down, at least 1); for
+// RGBA SSE2 averages four output pixels at a time, the scalar loop handles the rest, 1-texel
+// edges and the one and two component formats
+inline void downsampleBox(const unsigned char* srcTexels, const TextureLevel& src, unsigned char* dstTexels, const TextureLevel& dst, int components)
+{
+#ifdef TEXTURE_LOADER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+#endif
+    for (int y = 0; y < dst.height; y++)
+    {
+        const unsigned char* row0 = srcTexels + (size_t)std::min(2 * y, src.height - 1) * src.width * components;
+        const unsigned char* row1 = srcTexels + (size_t)std::min(2 * y + 1, src.height - 1) * src.width * components;
+        unsigned char* out = dstTexels + (size_t)y * dst.width * components;
+
+        int x = 0;
+#ifdef TEXTURE_LOADER_SSE2
+        if (components == 4 && src.width >= 2)
+        {
+            for (; x + 4 <= dst.width; x += 4)
+            {
+                // 8 source pixels per row; split them into even and odd pixels
+                __m128 a0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row0 + x * 8)));
+                __m128 b0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16)));
+                __m128 a1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row1 + x * 8)));
+                __m128 b1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16)));
+                __m128i even0 = _mm_castps_si128(_mm_shuffle_ps(a0, b0, _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i odd0 = _mm_castps_si128(_mm_shuffle_ps(a0, b0, _MM_SHUFFLE(3, 1, 3, 1)));
+                __m128i even1 = _mm_castps_si128(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i odd1 = _mm_castps_si128(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+                // sum the four in 16 bits, round and divide by 4
+                __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(even0, zero), _mm_unpacklo_epi8(odd0, zero)),
+                    _mm_add_epi16(_mm_unpacklo_epi8(even1, zero), _mm_unpacklo_epi8(odd1, zero)));
+                __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(even0, zero), _mm_unpackhi_epi8(odd0, zero)),
+                    _mm_add_epi16(_mm_unpackhi_epi8(even1, zero), _mm_unpackhi_epi8(odd1, zero)));
+                lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+                hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+                _mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        for (; x < dst.width; x++)
+        {
+            int x0 = std::min(2 * x, src.width - 1) * components;
+            int x1 = std::min(2 * x + 1, src.width - 1) * components;
+            for (int c = 0; c < components; c++)
+                out[x * components + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+// full chain down to 1x1 from an 8-bit image, laid out back to back in storage
+inline void buildMipChain(const unsigned char* image, int width, int height, int components, std::vector<TextureLevel>& levels,
+    std::vector<unsigned char>& storage)
+{
+    levels.clear();
+    size_t total = 0;
+    for (;;)
+    {
+        TextureLevel level = { width, height, total, (size_t)width * height * components };
+        levels.push_back(level);
+        total += level.size;
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    storage.resize(total);
+    std::copy(image, image + levels[0].size, storage.begin());
+    for (size_t i = 1; i < levels.size(); i++)
+        downsampleBox(&storage[levels[i - 1].offset], levels[i - 1], &storage[levels[i].offset], levels[i], components);
+}
+
+// bilinear sample of an 8-bit image at texel coordinates (x, y), clamped to the edges
+inline void sampleBilinear(const unsigned char* image, int width, int height, int components, float x, float y, unsigned char* out)
+{
+    x = std::min(std::max(x, 0.0f), (float)(width - 1));
+    y = std::min(std::max(y, 0.0f), (float)(height - 1));
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+    float fx = x - x0, fy = y - y0;
+    const unsigned char* row0 = image + (size_t)y0 * width * components;
+    const unsigned char* row1 = image + (size_t)y1 * width * components;
+    for (int c = 0; c < components; c++)
+    {
+        float top = row0[x0 * components + c] + (row0[x1 * components + c] - row0[x0 * components + c]) * fx;
+        float bottom = row1[x0 * components + c] + (row1[x1 * components + c] - row1[x0 * components + c]) * fx;
+        out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+    }
+}
+
+// scale an 8-bit image to another size: halve it with the box filter while it stays at least
+// twice the new size, so big reductions don't alias, then filter bilinearly the rest of the way
+inline void resampleImage(const unsigned char* image, int width, int height, int components, int newWidth, int newHeight,
+    std::vector<unsigned char>& out)
+{
+    std::vector<unsigned char> halved;
+    while (width >= newWidth * 2 && height >= newHeight * 2)
+    {
+        TextureLevel src = { width, height, 0, (size_t)width * height * components };
+        TextureLevel dst = { width / 2, height / 2, 0, (size_t)(width / 2) * (height / 2) * components };
+        std::vector<unsigned char> next(dst.size);
+        downsampleBox(image, src, next.data(), dst, components);
+        halved.swap(next);
+        image = halved.data();
+        width = dst.width;
+        height = dst.height;
+    }
+
+    out.resize((size_t)newWidth * newHeight * components);
+    float scaleX = (float)width / newWidth, scaleY = (float)height / newHeight;
+    for (int y = 0; y < newHeight; y++)
+    {
+        for (int x = 0; x < newWidth; x++)
+            sampleBilinear(image, width, height, components, (x + 0.5f) * scaleX - 0.5f, (y + 0.5f) * scaleY - 0.5f,
+                &out[((size_t)y * newWidth + x) * components]);
+    }
+}
+
+class TextureLoader
+{
+public:
+    // uploads per pump() are cut off after this many bytes, but at least one texture goes through
+    static const size_t UPLOAD_BUDGET = 16 * 1024 * 1024;
+
+    // cache hits and misses so far
+    unsigned int cacheHits;
+    unsigned int cacheMisses;
+
+    // bytes of texel data uploaded, i.e. the texture memory in use
+    size_t textureBytes;
+
+    // an empty cache directory turns the disk cache off; compression applies to colour textures
+    // the driver has a matching format for, everything else stays uncompressed
+    explicit TextureLoader(const std::string& cacheDirectory = "textureCache", TextureCompression compression = COMPRESSION_NONE,
+        unsigned int threads = 0)
+        : cacheHits(0), cacheMisses(0), textureBytes(0), cache(cacheDirectory), compression(compression), pending(0), stopping(false)
+    {
+        compressThreads = std::max(1u, std::thread::hardware_concurrency());
+        if (threads == 0)
+            threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+        for (unsigned int i = 0; i < threads; i++)
+            workers.push_back(std::thread(&TextureLoader::work, this));
+    }
+
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    // allocate an RGBA array of 'layers' images of one size, compressed if the loader compresses;
+    // it samples grey until every layer is loaded
+    void createArray(TextureArray& array, int width, int height, int layers, bool srgb = false)
+    {
+        TextureCompression blockFormat = compressionFor(4, srgb);
+        int levels = TextureArray::fullMipCount(width, height);
+        array.create(width, height, levels, layers, blockFormat != COMPRESSION_NONE ? compressedFormatFor(blockFormat, srgb)
+            : srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8);
+
+        unsigned char placeholder[16];
+        size_t placeholderSize = placeholderTexels(blockFormat, placeholder);
+        for (int layer = 0; layer < layers; layer++)
+            array.upload(levels - 1, layer, placeholder, placeholderSize);
+        array.setBaseLevel(levels - 1);
+    }
+
+    // load an image into the next free layer of an array made by createArray(); returns the
+    // layer, or -1 when the array is full
+    int loadLayer(TextureArray& array, const char* path)
+    {
+        if (array.assigned >= array.layers)
+        {
+            std::cerr << "No free texture array layer for " << path << std::endl;
+            return -1;
+        }
+
+        DecodedTexture job;
+        job.array = &array;
+        job.layer = array.assigned++;
+        job.width = array.width;
+        job.height = array.height;
+        job.path = path;
+        job.channels = 0;
+        job.components = 4;
+        job.format = array.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || array.internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? TEXEL_BC1
+            : array.compressed ? TEXEL_BC7 : TEXEL_RGBA8;
+        queue(job);
+        return job.layer;
+    }
+
+    // upload what the workers finished; call once per frame on the GL thread
+    void pump(size_t budget = UPLOAD_BUDGET)
+    {
+        TRACE_SCOPE("upload textures");
+        size_t uploaded = 0;
+        while (uploaded < budget)
+        {
+            DecodedTexture decoded;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (done.empty())
+                    return;
+                decoded = std::move(done.front());
+                done.pop_front();
+            }
+            uploaded += upload(decoded);
+        }
+    }
+
+    // block until every requested texture is uploaded, e.g. for reproducible screenshots
+    void finish()
+    {
+        TRACE_SCOPE("wait for textures");
+        while (getPending() > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [this] { return !done.empty(); });
+            }
+            pump((size_t)-1);
+        }
+    }
+
+    // textures requested but not uploaded yet
+    unsigned int getPending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+private:
+    TextureCache cache;
+    TextureCompression compression;
+    unsigned int compressThreads;       // per texture, for its big levels
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;       // jobs were queued or we are stopping
+    std::condition_variable finished;   // a decode finished
+    std::deque<DecodedTexture> jobs;
+    std::deque<DecodedTexture> done;
+    unsigned int pending;
+    bool stopping;
+
+    // block format for a texture, falling back to BC7 for alpha and to none when the driver
+    // lacks the format
+    TextureCompression compressionFor(int components, bool srgb) const
+    {
+        if (compression == COMPRESSION_NONE || components != 4)
+            return COMPRESSION_NONE;
+        bool hasBC1 = srgb ? glExt().s3tcSRGB : glExt().s3tc;
+        if (compression == COMPRESSION_BC1 && hasBC1)
+            return COMPRESSION_BC1;
+        return glExt().bptc ? COMPRESSION_BC7 : COMPRESSION_NONE;
+    }
+
+    static GLenum compressedFormatFor(TextureCompression blockFormat, bool srgb)
+    {
+        if (blockFormat == COMPRESSION_BC1)
+            return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+
+    // one grey RGBA texel, or one block of them; returns its size in bytes
+    static size_t placeholderTexels(TextureCompression blockFormat, unsigned char out[16])
+    {
+        const unsigned char grey[4] = { 128, 128, 128, 255 };
+        if (blockFormat == COMPRESSION_NONE)
+        {
+            std::copy(grey, grey + 4, out);
+            return 4;
+        }
+
+        unsigned char block[64];
+        for (int i = 0; i < 64; i += 4)
+            std::copy(grey, grey + 4, block + i);
+        if (blockFormat == COMPRESSION_BC1)
+            encodeBC1Block(block, out);
+        else
+            encodeBC7Block(block, out);
+        return (size_t)compressedBlockBytes(blockFormat);
+    }
+
+    void queue(DecodedTexture& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    void work()
+    {
+        cpuTrace().nameThread("texture worker");
+        for (;;)
+        {
+            DecodedTexture job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            decode(job);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(std::move(job));
+            }
+            finished.notify_all();
+        }
+    }
+
+    void decode(DecodedTexture& job)
+    {
+        TRACE_SCOPE("decode texture");
+        std::ifstream file(job.path.c_str(), std::ios::binary);
+        std::vector<unsigned char> source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (source.empty())
+            return;
+
+        // the cache entry is only used when it was made from exactly these bytes
+        unsigned long long sourceHash = hashBytes(source.data(), source.size());
+        unsigned int format;
+        int channels;
+        if (cache.read(job.path, sourceHash, job.mapping, job.levels, format, channels))
+        {
+            if (format == job.format && job.levels[0].width == job.width && job.levels[0].height == job.height)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                cacheHits++;
+                return;
+            }
+            job.mapping.close();
+            job.levels.clear();
+        }
+
+        // every layer is RGBA, whatever the source image has
+        int width, height;
+        unsigned char* data = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &job.channels, job.components);
+        if (!data)
+            return;
+
+        // every layer has the array's size
+        if (width != job.width || height != job.height)
+        {
+            std::vector<unsigned char> resampled;
+            resampleImage(data, width, height, job.components, job.width, job.height, resampled);
+            buildMipChain(resampled.data(), job.width, job.height, job.components, job.levels, job.storage);
+        }
+        else
+        {
+            buildMipChain(data, width, height, job.components, job.levels, job.storage);
+        }
+        stbi_image_free(data);
+
+        if (job.format == TEXEL_BC1 || job.format == TEXEL_BC7)
+        {
+            std::vector<TextureLevel> levels;
+            std::vector<unsigned char> blocks;
+            compressMipChain(job.storage.data(), job.levels, job.format == TEXEL_BC1 ? COMPRESSION_BC1 : COMPRESSION_BC7, levels, blocks, compressThreads);
+            job.levels.swap(levels);
+            job.storage.swap(blocks);
+        }
+
+        cache.write(job.path, sourceHash, job.storage.data(), job.levels, job.format, job.channels);
+        std::lock_guard<std::mutex> lock(mutex);
+        cacheMisses++;
+    }
+
+    // returns the number of bytes uploaded
+    size_t upload(const DecodedTexture& decoded)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        if (decoded.levels.empty())
+        {
+            std::cerr << "Failed to load texture " << decoded.path << std::endl;
+            layerDone(*decoded.array);
+            return 0;
+        }
+
+        // fill the levels straight from the decoded or mapped texels
+        size_t bytes = 0;
+        const unsigned char* texels = decoded.texels();
+        for (size_t level = 0; level < decoded.levels.size(); level++)
+        {
+            const TextureLevel& mip = decoded.levels[level];
+            decoded.array->upload((int)level, decoded.layer, texels + mip.offset, mip.size);
+            bytes += mip.size;
+        }
+        layerDone(*decoded.array);
+        textureBytes += bytes;
+        return bytes;
+    }
+
+    // the array's full chains are sampled once its last layer is in
+    void layerDone(TextureArray& array)
+    {
+        array.complete++;
+        if (array.complete == array.layers)
+            array.setBaseLevel(0);
+    }
+};
+
+#endif /* textureLoader_h */
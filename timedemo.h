@@ -0,0 +1,156 @@
+//
+//  timedemo.h
+//  3D-Shooter
+//
+//  Recording and replay of the player's input, plus frame time statistics, so the same
+//  flythrough can be benchmarked again and again.
+//
+
+#ifndef timedemo_h
+#define timedemo_h
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+
+// keys held during a frame
+enum InputKey {
+    INPUT_FORWARD = 1 << 0,
+    INPUT_BACKWARD = 1 << 1,
+    INPUT_LEFT = 1 << 2,
+    INPUT_RIGHT = 1 << 3,
+    INPUT_UP = 1 << 4,
+    INPUT_DOWN = 1 << 5,
+    INPUT_FIRE = 1 << 6
+};
+
+// everything the player did during one frame
+struct InputFrame
+{
+    float deltaTime;        // the time step the camera moved with
+    unsigned int keys;      // InputKey bits
+    float mouseX;           // summed mouse offsets, already reversed on y
+    float mouseY;
+    float scroll;
+};
+
+// feed one frame of input to the camera through the same entry points the live callbacks use;
+// returns whether fire was pressed
+inline bool applyInput(Camera& camera, const InputFrame& input)
+{
+    if (input.keys & INPUT_FORWARD)
+        camera.ProcessKeyboard(FORWARD, input.deltaTime);
+    if (input.keys & INPUT_BACKWARD)
+        camera.ProcessKeyboard(BACKWARD, input.deltaTime);
+    if (input.keys & INPUT_LEFT)
+        camera.ProcessKeyboard(LEFT, input.deltaTime);
+    if (input.keys & INPUT_RIGHT)
+        camera.ProcessKeyboard(RIGHT, input.deltaTime);
+    if (input.keys & INPUT_UP)
+        camera.ProcessKeyboard(UP, input.deltaTime);
+    if (input.keys & INPUT_DOWN)
+        camera.ProcessKeyboard(DOWN, input.deltaTime);
+    if (input.mouseX != 0.0f || input.mouseY != 0.0f)
+        camera.ProcessMouseMovement(input.mouseX, input.mouseY);
+    if (input.scroll != 0.0f)
+        camera.ProcessMouseScroll(input.scroll);
+    return (input.keys & INPUT_FIRE) != 0;
+}
+
+// a text file with one line per frame: deltaTime keys mouseX mouseY scroll
+class InputRecording
+{
+public:
+    std::vector<InputFrame> frames;
+
+    bool load(const char* path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::TIMEDEMO::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        frames.clear();
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            InputFrame frame;
+            if (!(fields >> frame.deltaTime >> frame.keys >> frame.mouseX >> frame.mouseY >> frame.scroll))
+            {
+                std::cout << "ERROR::TIMEDEMO::BAD_LINE: " << line << std::endl;
+                return false;
+            }
+            frames.push_back(frame);
+        }
+        return !frames.empty();
+    }
+
+    bool save(const char* path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::TIMEDEMO::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        file << "# 3D-Shooter input recording: deltaTime keys mouseX mouseY scroll\n";
+        file.precision(9);
+        for (size_t i = 0; i < frames.size(); i++)
+            file << frames[i].deltaTime << ' ' << frames[i].keys << ' ' << frames[i].mouseX << ' ' << frames[i].mouseY << ' ' << frames[i].scroll << '\n';
+        return true;
+    }
+};
+
+// per-frame samples of a benchmark run
+class FrameStats
+{
+public:
+    void add(double milliseconds, unsigned long long drawCalls, unsigned long long triangles)
+    {
+        times.push_back(milliseconds);
+        totalDrawCalls += drawCalls;
+        totalTriangles += triangles;
+    }
+
+    void print() const
+    {
+        if (times.empty())
+            return;
+        std::vector<double> sorted(times);
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (size_t i = 0; i < sorted.size(); i++)
+            sum += sorted[i];
+        double average = sum / sorted.size();
+        size_t n = sorted.size();
+
+        std::cout << "Timedemo: " << n << " frames in " << sum / 1000.0 << " s, " << 1000.0 / average << " fps" << std::endl;
+        std::cout << "  frame time ms: avg " << average << "  p50 " << percentile(sorted, 0.50) << "  p95 " << percentile(sorted, 0.95)
+            << "  p99 " << percentile(sorted, 0.99) << "  max " << sorted.back() << std::endl;
+        std::cout << "  per frame: " << (double)totalDrawCalls / n << " draw calls, " << (double)totalTriangles / n << " triangles" << std::endl;
+    }
+
+private:
+    std::vector<double> times;
+    unsigned long long totalDrawCalls = 0;
+    unsigned long long totalTriangles = 0;
+
+    // nearest-rank percentile of sorted samples
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = (size_t)std::ceil(p * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+};
+
+#endif /* timedemo_h */
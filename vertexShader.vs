@@ -1,11 +1,23 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aInstanceModel;   // per-instance, locations 3 to 6
+layout (location = 7) in vec3 aInstanceColor;   // per-instance color
+
+out vec3 InstanceColor;
+
+#include "frameData.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec3 color;
+uniform bool instanced;
+
+// must match the depth pre-pass, see vertexShaderForDepth.vs
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    mat4 M = instanced ? aInstanceModel : model;
+
+    gl_Position = projection * view * M * vec4(aPos, 1.0);
+    InstanceColor = instanced ? aInstanceColor : color;
 }
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aInstanceModel;   // per-instance, locations 3 to 6
+
+#include "frameData.glsl"
+
+uniform mat4 model;
+uniform bool instanced;
+
+// the lit pass tests against these depths with GL_EQUAL, so both must compute the same positions
+invariant gl_Position;
+
+void main()
+{
+    mat4 M = instanced ? aInstanceModel : model;
+
+    gl_Position = projection * view * M * vec4(aPos, 1.0);
+}
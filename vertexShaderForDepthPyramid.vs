@@ -0,0 +1,10 @@
+#version 330 core
+
+// a quad over the whole viewport from gl_VertexID alone, drawn as a 4 vertex triangle strip
+out vec2 TexCoords;
+
+void main()
+{
+    TexCoords = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+}
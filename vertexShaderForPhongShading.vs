@@ -2,20 +2,35 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in mat4 aInstanceModel;   // per-instance, locations 3 to 6
+layout (location = 7) in vec3 aInstanceColor;   // per-instance tint
+layout (location = 8) in float aInstanceLayer;  // per-instance texture array layer, -1 untextured
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
+out vec3 InstanceColor;
+flat out float Layer;
+out vec4 ClipPos;      // picks the fragment's light cluster
+
+#include "frameData.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool instanced;
+
+// must match the depth pre-pass, see vertexShaderForDepth.vs
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    mat4 M = instanced ? aInstanceModel : model;
+
+    gl_Position = projection * view * M * vec4(aPos, 1.0);
+    ClipPos = gl_Position;
+
+    FragPos = vec3(M * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(M))) * aNormal;
     TexCoord = aTexCoord;
+    InstanceColor = instanced ? aInstanceColor : vec3(1.0);
+    Layer = instanced ? aInstanceLayer : -1.0;
 }
@@ -0,0 +1,10 @@
+#version 330 core
+
+// one rectangle of the GPU profiler overlay from gl_VertexID alone, drawn as a 4 vertex triangle strip
+uniform vec4 rect;     // left, bottom, right, top in normalized device coordinates
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in mat4 aInstanceModel;   // per-instance, locations 3 to 6
+layout (location = 7) in vec3 aInstanceColor;   // per-instance tint
+layout (location = 8) in float aInstanceLayer;  // per-instance texture array layer
+
+out vec2 TexCoord;
+out vec3 InstanceColor;
+flat out float Layer;
+
+#include "frameData.glsl"
+
+void main()
+{
+    // z = w puts every fragment on the far plane, behind anything already drawn
+    gl_Position = (projection * view * aInstanceModel * vec4(aPos, 1.0)).xyww;
+    TexCoord = aTexCoord;
+    InstanceColor = aInstanceColor;
+    Layer = aInstanceLayer;
+}